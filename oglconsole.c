@@ -1,5 +1,10 @@
 /* oglconsole -- gpl license here */
 
+/* glibc only declares posix_openpt() and its friends when asked to */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#  define _GNU_SOURCE
+#endif
+
 /* This strategy seems to offer the convenience of zero-configuration, but
  * obviously it also offers defining GLHEADERINCLUDE */
 #ifdef __APPLE__
@@ -11,18 +16,54 @@
 #include "oglconsole.h"
 
 #include <string.h>
+#include <ctype.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <time.h>
+
+/* Scrollback can be kept in memory-mapped files, output copied to files,
+ * stdout and stderr captured, and programs run in consoles, where we have
+ * POSIX */
+#if defined(__unix__) || defined(__APPLE__)
+#  define OGLCONSOLE_POSIX
+#  include <sys/types.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <sys/uio.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <poll.h>
+#  include <errno.h>
+#  include <regex.h>
+#  include <signal.h>
+#  include <sys/ioctl.h>
+#  include <sys/wait.h>
+#  if defined(__linux__) && !defined(F_SETPIPE_SZ)
+#    define F_SETPIPE_SZ 1031
+#  endif
+#endif
+
+#if defined(__SSE2__)
+#  include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#  include <arm_neon.h>
+#endif
 
 #define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
 #ifdef OGLCONSOLE_USE_SDL
 #  define OGLCONSOLE_SLIDE
+#  define OGLCONSOLE_THREADS
 #endif
 
 #define C ((_OGLCONSOLE_Console*)console)
 
+/* Keeps the compiler and CPU from moving memory accesses across it, for data
+ * shared between threads without a lock */
+#define OGLCONSOLE_BARRIER() __sync_synchronize()
+
 /* OGLCONSOLE font */
 #include "font850.c"
 
@@ -40,6 +81,14 @@
  * "visible" console visibility modes */
 #define SLIDE_STEPS 25
 
+/* Smooth scrolling covers most of the way to where a key scrolls it in
+ * GLIDE_MS milliseconds. A turn of the mouse wheel flings the display
+ * WHEEL_ROWS rows, slowing as it goes: FLING_FRICTION is how fast it loses
+ * speed, as the exponent of its decay per second */
+#define GLIDE_MS 150
+#define WHEEL_ROWS 3
+#define FLING_FRICTION 6.0
+
 static GLdouble screenWidth, screenHeight;
 static GLuint OGLCONSOLE_glFontHandle = 0;
 static int OGLCONSOLE_CreateFont()
@@ -92,18 +141,407 @@ static int OGLCONSOLE_CreateFont()
  * of lines shown on the screen at all times) */
 #define DEFAULT_MAX_LINES 100
 
+/* Scrollback lives in fixed-size pages which are only allocated once a line on
+ * them gets written, so a console configured for millions of lines costs only
+ * what has actually been printed to it. Pages given up by a console go into a
+ * pool shared by all consoles, of which we keep at most MAX_POOLED_PAGES */
+#define OGLCONSOLE_PAGE_SIZE 16384
+#define MAX_POOLED_PAGES 64
+
+/* Once this many newer blocks of scrollback text have filled up, a block is
+ * considered cold and gets compressed by a background thread. Cold blocks are
+ * unpacked again when they're drawn, into a cache of UNPACKED_BLOCKS pages */
+#define HOT_BLOCKS 16
+#define UNPACKED_BLOCKS 8
+
+/* Lines of output longer than this are broken in two */
+#define MAX_LINE_LENGTH (OGLCONSOLE_PAGE_SIZE / 4)
+
+/* Consoles can look back over up to this many lines for one that a new line
+ * repeats */
+#define COALESCE_WINDOW 16
+
+/* Tab stops are every this many columns */
+#define TAB_WIDTH 8
+
+/* Output to a hidden console isn't indexed for searching as it comes in. Once
+ * the console is shown, this many lines of it are indexed each frame, and a
+ * search indexes whatever's left */
+#define INDEX_LINES_PER_FRAME 4096
+
+/* A page of scrollback text. Output is appended to a console's newest block
+ * until it fills up; every line whose text is in a block holds a reference to
+ * it, and the page goes back to the pool once the last of them is gone. Once a
+ * block is cold its text may be swapped for a compressed copy */
+typedef struct OGLCONSOLE_Block
+{
+    char *text, *packed;
+    int used, refs, packedSize;
+
+    /* Where the block is in its life: being written to, waiting to go cold,
+     * being compressed, or finished with */
+    enum { BLOCK_OPEN, BLOCK_HOT, BLOCK_PACKING, BLOCK_COLD } state;
+
+    /* Next block in whichever queue this one is waiting in */
+    struct OGLCONSOLE_Block *next;
+} OGLCONSOLE_Block;
+
+/* A line of console output exactly as it was printed. Lines only get wrapped
+ * to the width of the console when they are drawn. When the same line is
+ * printed again right away, we just count the repeat */
+typedef struct
+{
+    OGLCONSOLE_Block *block;
+    unsigned short offset, length, repeats;
+} OGLCONSOLE_Line;
+
+/* For searching, every run of BLOOM_LINES lines has a bloom filter of
+ * BLOOM_SIZE bytes, with a bit set for each trigram (ignoring case) in them.
+ * These are kept after the line records in each page */
+#define BLOOM_LINES 32
+#define BLOOM_SIZE 512
+
+/* How many line records (and their blooms) fit in one page */
+#define LINES_PER_PAGE ((long)(OGLCONSOLE_PAGE_SIZE \
+        / (BLOOM_LINES * sizeof(OGLCONSOLE_Line) + BLOOM_SIZE) * BLOOM_LINES))
+
+/* Each page of line records has the lines' metadata alongside it, each kind
+ * in an array of its own so that going through one kind touches nothing else:
+ * when the line was started (microseconds since the epoch), the channel and
+ * severity of the output which started it (channel UNTAGGED for untagged
+ * output), and the color it's drawn in (0xRRGGBB, or 0 for the usual) */
+#define UNTAGGED 0xff
+
+/* Parts of a line can be colored by codes in the output. Each line has a list
+ * of spans, in order, saying what color it is from column on (0 being the
+ * line's own color); before its first span, it's the line's own color. The
+ * spans of a page's lines are kept one line after another in spans, which
+ * holds spanSize of them; line N's start at spanStart[N % LINES_PER_PAGE] */
+typedef struct
+{
+    unsigned short column;
+    unsigned int color;
+} OGLCONSOLE_Span;
+
+typedef struct
+{
+    unsigned long long time[LINES_PER_PAGE];
+    unsigned int color[LINES_PER_PAGE];
+    unsigned char channel[LINES_PER_PAGE];
+    unsigned char severity[LINES_PER_PAGE];
+
+    unsigned int spanStart[LINES_PER_PAGE];
+    unsigned short spanCount[LINES_PER_PAGE];
+    OGLCONSOLE_Span *spans;
+    unsigned int spanSize;
+} OGLCONSOLE_Meta;
+
+/* Color codes are taken out of output as it comes in. An ANSI escape sequence
+ * (or a Quake '^') which is cut off at the end of some output is kept here, up
+ * to MAX_ESCAPE_LENGTH bytes of it, until the rest comes */
+#define MAX_ESCAPE_LENGTH 64
+
+/* A console in terminal mode acts like a VT100 (or near enough an xterm):
+ * output goes onto a screen of cells the size of the display, with escape
+ * sequences moving the cursor about, erasing, scrolling and coloring, rather
+ * than straight into the scrollback. Rows which scroll off the top of the
+ * screen do go into the scrollback */
+#define MAX_TERMINAL_PARAMS 16
+
+typedef struct
+{
+    int columns, rows;
+    char *cells;
+    unsigned int *colors;
+
+    /* The cursor, and whether the next character goes on the next row (the
+     * cursor stays on the last column until then) */
+    int x, y, wrapPending;
+    int savedX, savedY;
+    unsigned int color, savedColor;
+
+    /* The scrolling region, rows top up to bottom */
+    int top, bottom;
+
+    /* Modes: the cursor is shown, text wraps at the right edge, a newline
+     * returns too, and the alternate screen is on */
+    int cursorShown, autowrap, newlineMode, alternate;
+
+    /* While the alternate screen is on, the usual screen is kept here, as it
+     * was when the alternate one came on */
+    char *mainCells;
+    unsigned int *mainColors;
+    int mainColumns, mainRows;
+
+    /* Where the parser is, and the escape sequence it's in the middle of */
+    int state;
+    int params[MAX_TERMINAL_PARAMS], paramCount;
+    char intermediates[4];
+    int intermediateCount;
+
+    /* Rows written to since the screen was last drawn. Each row is drawn by
+     * a display list, rowLists[row], made from the front cells and colors,
+     * which are what the screen held then; hashes are kept of them too, and
+     * found for the rows written to (in backHashes) to see which have moved */
+    unsigned char *dirty;
+    char *frontCells;
+    unsigned int *frontColors;
+    unsigned long long *frontHashes, *backHashes;
+    GLuint lists, *rowLists;
+    int listColumns, listRows;
+} OGLCONSOLE_Terminal;
+
+#if defined(OGLCONSOLE_POSIX) && defined(OGLCONSOLE_THREADS)
+/* A child process running in a console's terminal, on a pseudo-terminal: fd
+ * is the master end, a reader thread copies what comes out of it into the
+ * console, and writing to wake stops the thread. It sets exited (with the
+ * console's queue locked) once the child has exited and all of its output has
+ * been read. Input the pty hasn't taken yet waits in input */
+typedef struct
+{
+    pid_t pid;
+    int fd, wake[2], exited;
+    SDL_Thread *thread;
+    char *input;
+    int inputLength, inputSize;
+} OGLCONSOLE_Child;
+#endif
+
+/* A console's scrollback can instead live in a pair of files which survive
+ * the program: a plain text file holding the output, one line per line, and
+ * an index file holding where each line starts in the text file. Both only
+ * ever grow, and both are mapped into memory, so a line is found by reading
+ * its entry in the index */
+typedef struct
+{
+    char magic[8];
+
+    /* Lines started so far (the last one is still being written to), and
+     * bytes of text written so far */
+    unsigned long long lines, length;
+
+    /* Offset into the text file where each line starts */
+    unsigned long long start[1];
+} OGLCONSOLE_FileIndex;
+
+#define OGLCONSOLE_FILE_MAGIC "OGLCIDX1"
+
+typedef struct
+{
+    int textFd, indexFd;
+    char *text;
+    OGLCONSOLE_FileIndex *index;
+    size_t textSize, indexSize;
+} OGLCONSOLE_File;
+
+/* A console can copy its output to up to MAX_SINKS other places: files,
+ * stdout, or a callback. Output waits for them in a SINK_BUFFER_SIZE buffer
+ * (a power of two) until the console's writer thread gets to it */
+#define MAX_SINKS 8
+#define SINK_BUFFER_SIZE (256 * 1024)
+
+typedef struct
+{
+    int fd;
+    void (*callback)(OGLCONSOLE_Console console, const char *text,
+                     int length, void *data);
+    void *data;
+} OGLCONSOLE_Sink;
+
+/* A console can show only the lines of its scrollback which match a regular
+ * expression (or contain a string, without POSIX regexes), and whose
+ * metadata passes a filter; pattern is NULL if only the latter. Matching
+ * lines are
+ * listed in lines[start] to lines[count - 1], oldest first. A new expression
+ * is applied to the scrollback already there by up to MAX_SCAN_THREADS
+ * workers, each taking up to SCAN_LINES lines (SCAN_BYTES of text) at a time
+ * from scanNext and marking those which match in hits; lines which are
+ * output meanwhile are listed as they come */
+#define MAX_SCAN_THREADS 8
+#define SCAN_LINES 256
+#define SCAN_BYTES (64 * 1024)
+
+typedef struct
+{
+    OGLCONSOLE_Console console;
+    char *pattern;
+#ifdef OGLCONSOLE_POSIX
+    regex_t regex;
+#endif
+
+    /* Lines must also be at least this severe, and if tagged, from one of
+     * these channels */
+    int minSeverity;
+    unsigned long channels;
+
+    long *lines;
+    long start, count, size;
+
+    long scanFirst, scanLast, scanNext;
+    unsigned char *hits;
+    int workers, threadCount, cancel;
+#ifdef OGLCONSOLE_THREADS
+    SDL_Thread *threads[MAX_SCAN_THREADS];
+#endif
+} OGLCONSOLE_View;
+
+/* Output queued for a console by other threads waits in a buffer of up to
+ * MAX_QUEUED_OUTPUT bytes until the console picks it up; past that, it's
+ * dropped */
+#define MAX_QUEUED_OUTPUT (1024 * 1024)
+
+/* A console can be given a budget of time per frame to spend putting output
+ * into its scrollback; output it hasn't got to waits in its backlog. The
+ * backlog is put in DRAIN_MIN_BATCH bytes or more at a time, sized to fit what
+ * is left of the budget, and never holds more than MAX_BACKLOG bytes */
+#define DRAIN_MIN_BATCH 256
+#define MAX_BACKLOG (16 * 1024 * 1024)
+
+/* Tagged output waits in the backlog like any other; each place in it where
+ * the channel and severity change is marked with one of these */
+typedef struct
+{
+    int offset;
+    signed char channel;
+    unsigned char severity;
+} OGLCONSOLE_BacklogTag;
+
+/* A console can pin up to MAX_PINNED_ROWS rows of text below (or above) its
+ * scrollback, for things like counters which change all the time. A pinned
+ * row can watch a variable, looking at it every interval milliseconds and
+ * formatting it afresh only if it has changed. Each row is drawn from a
+ * display list, which is only rebuilt when the row is dirty */
+#define MAX_PINNED_ROWS 8
+#define PINNED_LENGTH 256
+
+typedef struct
+{
+    char text[PINNED_LENGTH];
+    int length, dirty;
+
+    const void *variable;
+    char format[PINNED_LENGTH];
+    int type, sampled;
+    unsigned int interval, next;
+    union { int i; long l; float f; double d; } last;
+} OGLCONSOLE_Pin;
+
+/* Scrollback lines are drawn from display lists too, compiled the first time
+ * a line is drawn whole and kept in slot N % the number of slots for line N,
+ * like a ring following lineQueueIndex. Scrolling only compiles the lines it
+ * brings onto the display, and new output only the line it finishes; the
+ * line still being output to is drawn as it is. A slot remembers what its
+ * list was compiled from, and generation goes up whenever lines are laid out
+ * differently, which makes every list stale */
+#define LINE_LIST_SCREENS 2
+
+typedef struct
+{
+    long line;
+    int length, repeats;
+    unsigned int generation;
+} OGLCONSOLE_ListTag;
+
+/* A console's drawing is planned before any of it is done. The text which
+ * needs quads made for it goes into batches, as runs of text of one color,
+ * and what's to be done goes in a list of steps: compile a batch into a
+ * display list, call a display list, draw a batch as it is, or clip what's
+ * drawn next to the band height high from y up (or stop, if height is 0).
+ * Making the quads needs no GL, so Prepare() can have the batches of all the
+ * consoles built by a pool of up to MAX_BUILD_THREADS threads, leaving the
+ * GL thread only to send them. It's only worth waking the pool for
+ * BUILD_MIN_GLYPHS glyphs or more */
+#define MAX_BUILD_THREADS 8
+#define BUILD_MIN_GLYPHS 8192
+
+typedef struct
+{
+    int start, length;
+    float x, y;
+    unsigned int color;
+} OGLCONSOLE_Run;
+
+typedef struct
+{
+    char *text;
+    OGLCONSOLE_Run *runs;
+    float *quads;
+    int length, textSize, runCount, runSize, quadSize, built;
+    float w, h;
+} OGLCONSOLE_Batch;
+
+enum { STEP_DRAW, STEP_COMPILE, STEP_CALL, STEP_CLIP };
+
+typedef struct
+{
+    int type;
+    OGLCONSOLE_Batch *batch;
+    GLuint list;
+    double y, height;
+} OGLCONSOLE_Step;
+
+/* Unless told otherwise, consoles show tagged output of this severity and up */
+#define DEFAULT_MIN_SEVERITY OGLCONSOLE_INFO
+
 /* OGLCONSOLE console structure */
 typedef struct
 {
+    /* This has to come first, see OGLCONSOLE_WANTS() */
+    struct _OGLCONSOLE_Filter filter;
+
     GLdouble mvMatrix[16];
     int mvMatrixUse;
 
     GLdouble pMatrix[16];
     int pMatrixUse;
 
-    /* Screen+scrollback lines (console output) */
-    char *lines;
-    int maxLines, lineQueueIndex, lineScrollIndex;
+    /* Scrollback lines (console output). Lines are numbered from the first
+     * line ever output; the record for line N lives in page N/LINES_PER_PAGE,
+     * which is kept in slot (N/LINES_PER_PAGE)%pageCount of the pages[] wheel.
+     * lineQueueIndex is the line output is currently going to */
+    OGLCONSOLE_Line **pages;
+    int pageCount, maxLines;
+    long lineQueueIndex;
+
+    /* Metadata for the lines in pages[N] is in meta[N] */
+    OGLCONSOLE_Meta **meta;
+
+    /* What the output being put in the scrollback is tagged with, which goes
+     * in the metadata of lines it starts */
+    int outputChannel, outputSeverity;
+
+    /* Metadata to show to the left of lines (OGLCONSOLE_GUTTER_ flags), and
+     * how many columns it takes */
+    int gutter, gutterWidth;
+
+    /* Only lines at least this severe, and if tagged, from these channels,
+     * are shown */
+    int shownSeverity;
+    unsigned long shownChannels;
+
+    /* Output to a hidden console isn't put in the search index until the
+     * next search; this is the first line which may be missing from it, or
+     * -1 if none are */
+    long unindexed;
+
+    /* The block that output text is appended to */
+    OGLCONSOLE_Block *block;
+
+    /* If the scrollback is kept in a file, then it's all in here instead */
+    OGLCONSOLE_File *file;
+
+    /* The line at the bottom of the display, and how many of its wrapped rows
+     * are scrolled off below the bottom. While this is the line output is
+     * going to, and none of it is hidden, the display follows new output */
+    long lineScrollIndex;
+    int rowScrollIndex;
+
+    /* Smooth scrolling: how far past that row back the display is, as a
+     * fraction of a row; the rows still to glide through (negative is back)
+     * and the speed the mouse wheel has flung it at, in rows a second; and
+     * when it last moved */
+    double scrollFraction, scrollAhead, scrollVelocity;
+    unsigned int scrollTicks;
 
     /* History scrollback (command input) */
     char history[MAX_HISTORY_COUNT][MAX_INPUT_LENGTH];
@@ -116,9 +554,93 @@ typedef struct
     /* Rows and columns of text to display */
     int textWidth, textHeight;
 
-    /* Current column of text where new text will be inserted */
-    char *outputCursor;
-    int outputNewline;
+    /* Whether the next output begins a new line, and the column of the
+     * current line the next output goes to; a carriage return takes that
+     * back to 0, and output there writes over what the line already has */
+    int outputNewline, outputColumn;
+
+    /* Which color codes are taken out of output (OGLCONSOLE_COLORS_ flags),
+     * the color set by ANSI codes (until reset) and by Quake codes (until the
+     * end of the line), 0 being the usual, and an escape sequence we're in the
+     * middle of */
+    int colorCodes;
+    unsigned int ansiColor, quakeColor;
+    char escape[MAX_ESCAPE_LENGTH];
+    int escapeLength;
+
+    /* The screen, in terminal mode, or NULL */
+    OGLCONSOLE_Terminal *terminal;
+#if defined(OGLCONSOLE_POSIX) && defined(OGLCONSOLE_THREADS)
+    OGLCONSOLE_Child *child;
+#endif
+
+    /* Hashes of the last few lines of output, and which lines they were, so
+     * that repeats can be counted instead of output again. We look back over
+     * the last "coalesce" of them, or not at all if that's zero */
+    unsigned long recentHash[COALESCE_WINDOW];
+    long recentLine[COALESCE_WINDOW];
+    int recentNext, coalesce;
+
+    /* Sinks output is copied to. The console writes into sinkBuffer at
+     * sinkHead, and the writer thread reads from it at sinkTail; both only
+     * ever count up. What doesn't fit is dropped unless sinkBlock is set */
+    OGLCONSOLE_Sink sinks[MAX_SINKS];
+    int sinkCount, sinkBlock;
+    char *sinkBuffer;
+    volatile unsigned long sinkHead, sinkTail;
+    unsigned long sinkDropped;
+#ifdef OGLCONSOLE_THREADS
+    SDL_Thread *sinkThread;
+    SDL_sem *sinkWork;
+    volatile int sinkQuit;
+#endif
+
+#ifdef OGLCONSOLE_THREADS
+    /* Output queued from other threads, waiting for the console to be drawn
+     * or output to */
+    char *queued;
+    int queuedLength, queuedSize;
+    SDL_mutex *queueLock;
+#endif
+
+    /* Output waiting to be put in the scrollback, while the console only
+     * spends drainBudget microseconds a frame doing that (0 is no limit).
+     * backlogStart is how far into it we've got, and drainCost is about how
+     * many microseconds a byte of it takes */
+    char *backlog;
+    int backlogStart, backlogLength, backlogSize;
+
+    /* Where the tags of the backlog change; tags[tagStart] is the one at
+     * backlogStart, and without any, the backlog is all untagged */
+    OGLCONSOLE_BacklogTag *tags;
+    int tagStart, tagCount, tagSize;
+    unsigned int drainBudget;
+    double drainCost;
+
+    /* If only lines matching an expression are shown, view lists them. A new
+     * expression waits as pendingView while the scrollback is scanned, and
+     * the old view (if any) is shown until it's done */
+    OGLCONSOLE_View *view, *pendingView;
+
+    /* Pinned rows, which are at the top of the console if pinnedTop is set and
+     * otherwise at the bottom, and the display lists they're drawn from */
+    OGLCONSOLE_Pin pinned[MAX_PINNED_ROWS];
+    int pinnedCount, pinnedTop;
+    GLuint pinnedLists;
+
+    /* Display lists of scrollback lines, LINE_LIST_SCREENS screens of them,
+     * and what each was compiled from */
+    GLuint lineLists;
+    OGLCONSOLE_ListTag *lineTags;
+    int lineListCount;
+    unsigned int listGeneration;
+
+    /* This frame's drawing as it's been planned, and the frame Prepare()
+     * planned it and built its batches in, if it did (0 if not) */
+    OGLCONSOLE_Batch **batches;
+    OGLCONSOLE_Step *steps;
+    int batchCount, batchSize, stepCount, stepSize;
+    unsigned int plannedFrame;
 
     /* Width and height of a single character for the GL */
     GLdouble characterWidth, characterHeight;
@@ -132,599 +654,6549 @@ typedef struct
     /* Various callback functions defined by the user */
     void(*enterKeyCallback)(OGLCONSOLE_Console console, char *cmd);
 
-} _OGLCONSOLE_Console;
+    /* Broadcast groups the console belongs to, bit N for group N, and the
+     * next console there is */
+    unsigned long groups;
+    OGLCONSOLE_Console next;
 
-/* To save code, I've gone with an imperative "modal" kind of interface */
-_OGLCONSOLE_Console *programConsole = NULL;
+} _OGLCONSOLE_Console;
 
-/* This console is the console currently receiving user input */
-_OGLCONSOLE_Console *userConsole = NULL;
+/* Pages which consoles have given up, waiting to be recycled; the first bytes
+ * of each pooled page point to the next one */
+static void *OGLCONSOLE_pagePool = NULL;
+static int OGLCONSOLE_pooledPages = 0;
 
-/* Set the callback for a console */
-void OGLCONSOLE_EnterKey(void(*cbfun)(OGLCONSOLE_Console console, char *cmd))
+/* Take a blank page from the pool, or from malloc() if the pool is empty */
+static char *OGLCONSOLE_AllocPage()
 {
-    programConsole->enterKeyCallback = cbfun;
-}
+    char *page = OGLCONSOLE_pagePool;
 
-static
-void OGLCONSOLE_DefaultEnterKeyCallback(OGLCONSOLE_Console console, char *cmd)
-{
-    OGLCONSOLE_Output(console,
-            "No enter key callback is registered for this console!\n");
+    if (page)
+    {
+        OGLCONSOLE_pagePool = *(void**)page;
+        OGLCONSOLE_pooledPages--;
+    }
+    else if (!(page = malloc(OGLCONSOLE_PAGE_SIZE)))
+        return NULL;
+
+    memset(page, 0, OGLCONSOLE_PAGE_SIZE);
+    return page;
 }
 
-OGLCONSOLE_Console OGLCONSOLE_Create()
+/* Give a page back to the pool, or back to the system if the pool is full */
+static void OGLCONSOLE_FreePage(void *page)
 {
-    _OGLCONSOLE_Console *console;
-    GLint viewport[4];
-
-    /* If font hasn't been created, we create it */
-    if (!glIsTexture(OGLCONSOLE_glFontHandle))
-        OGLCONSOLE_CreateFont();
+    if (!page) return;
 
-    /* Allocate memory for our console */
-    console = (void*)malloc(sizeof(_OGLCONSOLE_Console));
- 
-    /* Textual dimensions */
-    glGetIntegerv(GL_VIEWPORT, viewport);
-    console->textWidth = viewport[2] / CHAR_PIXEL_W;
-    console->textHeight = viewport[3] / CHAR_PIXEL_H;
-    screenWidth = (GLdouble)viewport[2] / (GLdouble)CHAR_PIXEL_W;
-    screenHeight = (GLdouble)viewport[3] / (GLdouble)CHAR_PIXEL_H;
-    console->characterWidth = 1.0 / floor(screenWidth);
-    console->characterHeight = 1.0 / floor(screenHeight);
+    if (OGLCONSOLE_pooledPages >= MAX_POOLED_PAGES)
+    {
+        free(page);
+        return;
+    }
 
-    /* Different values have different meanings for xMatrixUse:
-        0) Do not change the matrix before rendering
-        1) Upload the console's matrix before rendering
-        2) Multiply the console's matrix before rendering */
+    *(void**)page = OGLCONSOLE_pagePool;
+    OGLCONSOLE_pagePool = page;
+    OGLCONSOLE_pooledPages++;
+}
 
-    /* Initialize its projection matrix */
-    console->pMatrixUse = 1;
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glLoadIdentity();
-    glOrtho(0, screenWidth, 0, screenHeight, -1, 1);
-    glGetDoublev(GL_PROJECTION_MATRIX, console->pMatrix);
-    glPopMatrix();
+/* Get a fresh block to append text to, or NULL if we're out of memory */
+static OGLCONSOLE_Block *OGLCONSOLE_NewBlock()
+{
+    OGLCONSOLE_Block *block = malloc(sizeof(OGLCONSOLE_Block));
 
-    /* Initialize its modelview matrix */
-    console->mvMatrixUse = 1;
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
-    glLoadIdentity();
-    glScaled(console->textWidth, console->textHeight, 1);
-    glGetDoublev(GL_MODELVIEW_MATRIX, console->mvMatrix);
-    glPopMatrix();
+    if (!block) return NULL;
 
-    /* Screen and scrollback lines */
-    /* This is the total number of screen lines in memory (start blank) */
-    console->maxLines = DEFAULT_MAX_LINES;
-    /* Allocate space for text */
-    console->lines = (char*)malloc(console->maxLines*(console->textWidth+1));
-    /* Initialize to empty strings */
-    memset(console->lines, 0, console->maxLines*(console->textWidth+1));
-    /* This variable represents whether or not a newline has been left */
-    console->outputNewline = 0;
-    /* This cursor points to the X pos where console output is next destined */
-    console->outputCursor = console->lines;
-    /* This cursor points to what line console output is next destined for */
-    console->lineQueueIndex = 0;
-    /* This cursor points to what line the console view is scrolled to */
-    console->lineScrollIndex = console->maxLines - console->textHeight + 1;
+    if (!(block->text = OGLCONSOLE_AllocPage()))
+    {
+        free(block);
+        return NULL;
+    }
 
-    /* Initialize the user's input (command line) */
-    console->inputLineLength = 0;
-    console->inputCursorPos = 0;
-    console->inputLine[0] = '\0';
+    block->packed = NULL;
+    block->used = 0;
+    block->refs = 1;
+    block->packedSize = 0;
+    block->state = BLOCK_OPEN;
+    block->next = NULL;
+    return block;
+}
 
-    /* History lines */
-    memset(console->history, 0, MAX_INPUT_LENGTH * MAX_HISTORY_COUNT);
-    console->historyQueueIndex = 0;
-    console->historyScrollIndex = -1;
+/* Cache of unpacked cold blocks, least recently used goes first */
+static struct
+{
+    OGLCONSOLE_Block *block;
+    char *text;
+    unsigned int used;
+} OGLCONSOLE_unpacked[UNPACKED_BLOCKS];
+static unsigned int OGLCONSOLE_unpackClock = 0;
+
+/* Free a block for good */
+static void OGLCONSOLE_FreeBlock(OGLCONSOLE_Block *block)
+{
+    int i;
 
-    /* Callbacks */
-    console->enterKeyCallback = OGLCONSOLE_DefaultEnterKeyCallback;
+    for (i = 0; i < UNPACKED_BLOCKS; i++)
+        if (OGLCONSOLE_unpacked[i].block == block)
+            OGLCONSOLE_unpacked[i].block = NULL;
 
-    /* The console starts life invisible */
-    console->visible = 0;
-    console->transitionComplete = 0;
+    OGLCONSOLE_FreePage(block->text);
+    free(block->packed);
+    free(block);
+}
 
-    /* If no consoles existed before, we select this one for convenience */
-    if (!programConsole) programConsole = console;
-    if (!userConsole) userConsole = console;
+/* Drop a reference to a block, freeing it when nobody refers to it anymore. A
+ * block which is waiting in a queue can only give up its text; the queue's
+ * owner frees the rest when it gets to it */
+static void OGLCONSOLE_ReleaseBlock(OGLCONSOLE_Block *block)
+{
+    if (!block || --block->refs > 0) return;
 
+    if (block->state == BLOCK_HOT)
+    {
+        OGLCONSOLE_FreePage(block->text);
+        block->text = NULL;
+    }
+    else if (block->state != BLOCK_PACKING)
+        OGLCONSOLE_FreeBlock(block);
+}
 
+/* Compress n bytes with a small LZ77 codec, in the spirit of LZ4. The output
+ * is a series of sequences, each a token byte holding a literal count and a
+ * match length, the literals, and then a 16 bit offset back to the match; the
+ * last sequence has no match. Counts of 15 continue in following bytes. We
+ * return the packed size, or 0 if it doesn't fit in max bytes */
+#define PACK_HASH_BITS 12
+#define PACK_MIN_MATCH 4
+
+static unsigned char *OGLCONSOLE_PackSequence(unsigned char *op,
+                                              unsigned char *oend,
+                                              const unsigned char *literals,
+                                              int literalCount,
+                                              int offset, int matchLength)
+{
+    unsigned char *token = op++;
+    int n, m = matchLength ? matchLength - PACK_MIN_MATCH : 0;
 
+    if (oend - op < literalCount + literalCount / 255 + m / 255 + 6)
+        return NULL;
 
-    /* Temporary shit */
-    OGLCONSOLE_Output((void*)console, "Console initialized\n");
+    *token = (literalCount < 15 ? literalCount : 15) << 4 | (m < 15 ? m : 15);
 
-    OGLCONSOLE_Output((void*)console,
-            "Console display lines:\t\t%i\n", console->textHeight);
+    if (literalCount >= 15)
+    {
+        for (n = literalCount - 15; n >= 255; n -= 255) *op++ = 255;
+        *op++ = n;
+    }
 
-    OGLCONSOLE_Output((void*)console,
-            "Console display columns:\t%i\n", console->textWidth);
+    memcpy(op, literals, literalCount);
+    op += literalCount;
 
-    OGLCONSOLE_Output((void*)console,
-            "Console input length:\t\t%i\n", MAX_INPUT_LENGTH);
+    if (matchLength)
+    {
+        *op++ = offset & 255;
+        *op++ = offset >> 8;
 
+        if (m >= 15)
+        {
+            for (n = m - 15; n >= 255; n -= 255) *op++ = 255;
+            *op++ = n;
+        }
+    }
 
-    /* Return the opaque pointer to the programmer */
-    return (OGLCONSOLE_Console)console;
+    return op;
 }
 
-/* This functoin is only used internally; the user ultimately invokes this
- * function through either a call to Destroy() or Quit(); the purpose of this
- * mechanism is to warn the user if he has explicitly destroyed a console that
- * was engaged in operation at the time they destroyed it (the only two
- * operations a console can be engaged in are receiving programmer interaction,
- * or receiving end-user interaction. fyi, "user" always refers to the
- * programmer, end-user refers to the real end-user) */
-static void OGLCONSOLE_DestroyReal(OGLCONSOLE_Console console, int safe)
+static int OGLCONSOLE_Pack(const unsigned char *in, int n,
+                           unsigned char *out, int max)
 {
-    free(C);
+    /* Positions (plus one) of recently seen four byte sequences */
+    unsigned short table[1 << PACK_HASH_BITS];
 
-    if (safe)
+    const unsigned char *ip = in, *anchor = in, *end = in + n;
+    unsigned char *op = out, *oend = out + max;
+
+    memset(table, 0, sizeof(table));
+
+    while (end - ip >= PACK_MIN_MATCH)
     {
-        if (programConsole == C)
-        {
-            fprintf(stderr, 
-            "Warning: OGLCONSOLE you just destroyed the programConsole!\n");
-            programConsole = NULL;
-        }
+        unsigned int h;
+        const unsigned char *ref;
+        int length;
 
-        if (userConsole == C)
+        memcpy(&h, ip, 4);
+        h = (h * 2654435761u) >> (32 - PACK_HASH_BITS);
+        ref = table[h] ? in + table[h] - 1 : NULL;
+        table[h] = ip - in + 1;
+
+        if (!ref || memcmp(ref, ip, PACK_MIN_MATCH))
         {
-            fprintf(stderr,
-            "Warning: OGLCONSOLE you just destroyed the userConsole!\n");
-            userConsole = NULL;
+            ip++;
+            continue;
         }
+
+        for (length = PACK_MIN_MATCH;
+             ip + length < end && ref[length] == ip[length];
+             length++);
+
+        op = OGLCONSOLE_PackSequence(op, oend, anchor, ip - anchor,
+                                     ip - ref, length);
+        if (!op) return 0;
+
+        ip += length;
+        anchor = ip;
     }
+
+    op = OGLCONSOLE_PackSequence(op, oend, anchor, end - anchor, 0, 0);
+    return op ? op - out : 0;
 }
 
-/* The user can call this function to free a console. A warning is printed to
- * stderr if the user has destroyed a console destroyed while it was receiving
- * input, see DestroyReal() for details TODO: there are currently no semantics
- * under consideration for explicitly destroying an 'engaged' console WITHOUT
- * having a warning issued, nor is there a way to deselect a console without
- * also selecting a new one as of yet */
-void OGLCONSOLE_Destroy(OGLCONSOLE_Console console)
+/* Undo OGLCONSOLE_Pack(); returns the unpacked size, or -1 if the input makes
+ * no sense */
+static int OGLCONSOLE_Unpack(const unsigned char *in, int n,
+                             unsigned char *out, int max)
 {
-    OGLCONSOLE_DestroyReal(console, 1);
+    const unsigned char *ip = in, *iend = in + n;
+    unsigned char *op = out, *oend = out + max;
+
+    while (ip < iend)
+    {
+        const unsigned char *ref;
+        int token = *ip++, count = token >> 4, b;
+
+        if (count == 15)
+            do { b = ip < iend ? *ip++ : 0; count += b; } while (b == 255);
+
+        if (count > iend - ip || count > oend - op) return -1;
+        memcpy(op, ip, count);
+        op += count;
+        ip += count;
+
+        /* The last sequence has no match */
+        if (ip >= iend) break;
+
+        if (iend - ip < 2) return -1;
+        ref = op - (ip[0] | ip[1] << 8);
+        ip += 2;
+
+        count = token & 15;
+        if (count == 15)
+            do { b = ip < iend ? *ip++ : 0; count += b; } while (b == 255);
+        count += PACK_MIN_MATCH;
+
+        if (ref < out || ref >= op || count > oend - op) return -1;
+
+        /* Matches may overlap what they're copying */
+        while (count--) *op++ = *ref++;
+    }
+
+    return op - out;
 }
 
-/* This function frees all of the consoles that the library is actively aware
- * of, and is intended to be used by programs that have only a single console;
- * technically this particular function will free up to two consoles, but don't
- * count on it because that may change; no warnings are issued by this function */
-void OGLCONSOLE_Quit()
+/* Compress a cold block, setting packed to NULL if it isn't worth it. This may
+ * run on the packer thread, so it only touches the block's text and packed */
+static void OGLCONSOLE_PackBlock(OGLCONSOLE_Block *block)
 {
-    if (programConsole)
-        OGLCONSOLE_DestroyReal((void*)programConsole, 0);
+    static unsigned char buffer[OGLCONSOLE_PAGE_SIZE];
+    int n = OGLCONSOLE_Pack((unsigned char*)block->text, block->used,
+                            buffer, block->used - block->used / 8);
 
-    if (programConsole != userConsole && userConsole)
-        OGLCONSOLE_DestroyReal((void*)userConsole, 0);
+    block->packed = n ? malloc(n) : NULL;
+    block->packedSize = n;
 
-    programConsole = NULL;
-    userConsole = NULL;
+    if (block->packed)
+        memcpy(block->packed, buffer, n);
 }
 
-/* THESE TWO FUNCTIONS EditConsole() and FocusConsole...
+/* A block has been packed; swap its text for the packed copy */
+static void OGLCONSOLE_FinishBlock(OGLCONSOLE_Block *block)
+{
+    block->state = BLOCK_COLD;
 
- * function is intended for use by applications which create MORE THAN ONE
- * console, since every newly created console is automatically selected for
- * programmer input ('programmer input' refers to calling any function which
- * does not specify a console explicitly in its parameter list. the console
- * which is 'engaged' by 'programmer input' at the time of calling one of these
- * functions is the console that function will operate on */
+    if (block->refs <= 0)
+        OGLCONSOLE_FreeBlock(block);
+    else if (block->packed)
+    {
+        OGLCONSOLE_FreePage(block->text);
+        block->text = NULL;
+    }
+}
 
-/* This routine selects a console to receive keyboard interaction from the user */
-void OGLCONSOLE_FocusConsole(OGLCONSOLE_Console console) { userConsole = C; }
+/* Blocks which are full but still hot, oldest first */
+static OGLCONSOLE_Block *OGLCONSOLE_hotHead = NULL, *OGLCONSOLE_hotTail = NULL;
+static int OGLCONSOLE_hotBlocks = 0;
 
-/* This routine selects a console to be the target of modification commands from
- * the programmer */
-void OGLCONSOLE_EditConsole(OGLCONSOLE_Console console) { programConsole = C; }
+#ifdef OGLCONSOLE_THREADS
+/* Held by workers scanning the scrollback while they copy text out of it, and
+ * by everything which changes or frees scrollback while there are workers. It
+ * only exists once there have been workers */
+static SDL_mutex *OGLCONSOLE_storageLock = NULL;
 
-/* Show or hide a console */
-void OGLCONSOLE_SetVisibility(int visible)
+static void OGLCONSOLE_LockStorage()
 {
-    programConsole->visible = visible ? -1 : 0;
-}
-/* Query console visibility */
-int OGLCONSOLE_GetVisibility() {
-    return programConsole->visible;
+    if (OGLCONSOLE_storageLock) SDL_mutexP(OGLCONSOLE_storageLock);
 }
 
-/* Get current configuration information about a console */
-void OGLCONSOLE_Info()
+static void OGLCONSOLE_UnlockStorage()
+{
+    if (OGLCONSOLE_storageLock) SDL_mutexV(OGLCONSOLE_storageLock);
+}
+
+/* Cold blocks waiting for the packer thread, and those it is done with */
+static OGLCONSOLE_Block *OGLCONSOLE_packQueue = NULL, *OGLCONSOLE_packed = NULL;
+static SDL_Thread *OGLCONSOLE_packThread = NULL;
+static SDL_mutex *OGLCONSOLE_packLock = NULL;
+static SDL_sem *OGLCONSOLE_packWork = NULL;
+static int OGLCONSOLE_packQuit = 0;
+
+/* The packer thread compresses whatever it's given, one block at a time */
+static int OGLCONSOLE_PackThread(void *unused)
+{
+    for (;;)
+    {
+        OGLCONSOLE_Block *block;
+
+        SDL_SemWait(OGLCONSOLE_packWork);
+
+        SDL_mutexP(OGLCONSOLE_packLock);
+        block = OGLCONSOLE_packQueue;
+        if (block) OGLCONSOLE_packQueue = block->next;
+        SDL_mutexV(OGLCONSOLE_packLock);
+
+        if (!block)
+        {
+            if (OGLCONSOLE_packQuit) return 0;
+            continue;
+        }
+
+        OGLCONSOLE_PackBlock(block);
+
+        SDL_mutexP(OGLCONSOLE_packLock);
+        block->next = OGLCONSOLE_packed;
+        OGLCONSOLE_packed = block;
+        SDL_mutexV(OGLCONSOLE_packLock);
+    }
+}
+
+/* Swap in the results of the packer thread's work so far */
+static void OGLCONSOLE_CollectPacked()
+{
+    OGLCONSOLE_Block *block;
+
+    if (!OGLCONSOLE_packThread) return;
+
+    SDL_mutexP(OGLCONSOLE_packLock);
+    block = OGLCONSOLE_packed;
+    OGLCONSOLE_packed = NULL;
+    SDL_mutexV(OGLCONSOLE_packLock);
+
+    while (block)
+    {
+        OGLCONSOLE_Block *next = block->next;
+        OGLCONSOLE_FinishBlock(block);
+        block = next;
+    }
+}
+
+/* Stop the packer thread once it has finished everything it was given */
+static void OGLCONSOLE_StopPacking()
+{
+    if (!OGLCONSOLE_packThread) return;
+
+    OGLCONSOLE_packQuit = 1;
+    SDL_SemPost(OGLCONSOLE_packWork);
+    SDL_WaitThread(OGLCONSOLE_packThread, NULL);
+
+    OGLCONSOLE_CollectPacked();
+    OGLCONSOLE_packThread = NULL;
+
+    SDL_DestroySemaphore(OGLCONSOLE_packWork);
+    SDL_DestroyMutex(OGLCONSOLE_packLock);
+    OGLCONSOLE_packQuit = 0;
+}
+#else
+#  define OGLCONSOLE_LockStorage()
+#  define OGLCONSOLE_UnlockStorage()
+#  define OGLCONSOLE_CollectPacked()
+#  define OGLCONSOLE_StopPacking()
+#endif
+
+/* Send a cold block off to be compressed. Without threads, we just do it */
+static void OGLCONSOLE_PackLater(OGLCONSOLE_Block *block)
+{
+    block->state = BLOCK_PACKING;
+
+#ifdef OGLCONSOLE_THREADS
+    if (!OGLCONSOLE_packThread)
+    {
+        OGLCONSOLE_packLock = SDL_CreateMutex();
+        OGLCONSOLE_packWork = SDL_CreateSemaphore(0);
+        OGLCONSOLE_packThread = SDL_CreateThread(OGLCONSOLE_PackThread, NULL);
+    }
+
+    if (OGLCONSOLE_packThread)
+    {
+        SDL_mutexP(OGLCONSOLE_packLock);
+        block->next = OGLCONSOLE_packQueue;
+        OGLCONSOLE_packQueue = block;
+        SDL_mutexV(OGLCONSOLE_packLock);
+        SDL_SemPost(OGLCONSOLE_packWork);
+        return;
+    }
+#endif
+
+    OGLCONSOLE_PackBlock(block);
+    OGLCONSOLE_FinishBlock(block);
+}
+
+/* A console has filled a block and moved on. It waits in the hot queue until
+ * HOT_BLOCKS newer blocks have filled up, and is then packed. Blocks whose
+ * lines all rolled out of the scrollback while they waited just get freed */
+static void OGLCONSOLE_SealBlock(OGLCONSOLE_Block *block)
+{
+    if (!block) return;
+
+    block->state = BLOCK_HOT;
+    block->next = NULL;
+
+    if (OGLCONSOLE_hotTail)
+        OGLCONSOLE_hotTail->next = block;
+    else
+        OGLCONSOLE_hotHead = block;
+    OGLCONSOLE_hotTail = block;
+
+    if (++OGLCONSOLE_hotBlocks <= HOT_BLOCKS) return;
+
+    block = OGLCONSOLE_hotHead;
+    if (!(OGLCONSOLE_hotHead = block->next))
+        OGLCONSOLE_hotTail = NULL;
+    OGLCONSOLE_hotBlocks--;
+
+    if (block->refs <= 0)
+        OGLCONSOLE_FreeBlock(block);
+    else
+        OGLCONSOLE_PackLater(block);
+}
+
+/* Once the consoles are gone, let go of the blocks they left in the queues and
+ * of the unpacked block cache */
+static void OGLCONSOLE_FreeBlocks()
+{
+    OGLCONSOLE_Block **b = &OGLCONSOLE_hotHead, *block;
+    int i;
+
+    OGLCONSOLE_StopPacking();
+
+    OGLCONSOLE_hotTail = NULL;
+    while ((block = *b))
+    {
+        if (block->refs <= 0)
+        {
+            *b = block->next;
+            OGLCONSOLE_hotBlocks--;
+            OGLCONSOLE_FreeBlock(block);
+        }
+        else
+        {
+            OGLCONSOLE_hotTail = block;
+            b = &block->next;
+        }
+    }
+
+    for (i = 0; i < UNPACKED_BLOCKS; i++)
+    {
+        OGLCONSOLE_FreePage(OGLCONSOLE_unpacked[i].text);
+        OGLCONSOLE_unpacked[i].text = NULL;
+        OGLCONSOLE_unpacked[i].block = NULL;
+    }
+}
+
+/* Returns the text of a block, unpacking it into the cache if it's cold */
+static const char *OGLCONSOLE_BlockText(OGLCONSOLE_Block *block)
+{
+    int i, victim = 0;
+
+    if (block->text)
+        return block->text;
+
+    for (i = 0; i < UNPACKED_BLOCKS; i++)
+    {
+        if (OGLCONSOLE_unpacked[i].block == block)
+        {
+            OGLCONSOLE_unpacked[i].used = ++OGLCONSOLE_unpackClock;
+            return OGLCONSOLE_unpacked[i].text;
+        }
+
+        if (OGLCONSOLE_unpacked[i].used < OGLCONSOLE_unpacked[victim].used)
+            victim = i;
+    }
+
+    if (!OGLCONSOLE_unpacked[victim].text
+    && !(OGLCONSOLE_unpacked[victim].text = OGLCONSOLE_AllocPage()))
+        return NULL;
+
+    OGLCONSOLE_unpacked[victim].block = NULL;
+    if (OGLCONSOLE_Unpack((unsigned char*)block->packed, block->packedSize,
+                (unsigned char*)OGLCONSOLE_unpacked[victim].text,
+                OGLCONSOLE_PAGE_SIZE) != block->used)
+        return NULL;
+
+    OGLCONSOLE_unpacked[victim].block = block;
+    OGLCONSOLE_unpacked[victim].used = ++OGLCONSOLE_unpackClock;
+    return OGLCONSOLE_unpacked[victim].text;
+}
+
+/* Release a page of line records, and the text they refer to */
+static void OGLCONSOLE_FreeLines(OGLCONSOLE_Line *page)
+{
+    long i;
+
+    if (!page) return;
+
+    for (i = 0; i < LINES_PER_PAGE; i++)
+        OGLCONSOLE_ReleaseBlock(page[i].block);
+
+    OGLCONSOLE_FreePage(page);
+}
+
+/* The oldest line still in the scrollback */
+static long OGLCONSOLE_FirstLine(_OGLCONSOLE_Console *console)
+{
+    long first = console->lineQueueIndex - console->maxLines + 1;
+    return first < 0 ? 0 : first;
+}
+
+/* Returns the metadata covering line N, which is at [N % LINES_PER_PAGE] in
+ * it, or NULL if there's no such line or no metadata for it. Scrollback kept
+ * in a file has none */
+static OGLCONSOLE_Meta *OGLCONSOLE_LineMeta(_OGLCONSOLE_Console *console,
+                                            long line)
+{
+    long slot = (line / LINES_PER_PAGE) % console->pageCount;
+
+    if (console->file || !console->meta || !console->pages[slot]
+     || line < OGLCONSOLE_FirstLine(console) || line > console->lineQueueIndex)
+        return NULL;
+
+    return console->meta[slot];
+}
+
+/* What color lines of each severity are drawn in, 0 for the usual */
+static const unsigned int OGLCONSOLE_severityColors[OGLCONSOLE_SEVERITIES] =
+{
+    0x808080, 0xa0a0a0, 0, 0xffff00, 0xff4040
+};
+
+/* Write the gutter for line N into buffer, gutterWidth characters of it:
+ * when it was started, the first letter of its severity, and its channel.
+ * Untagged lines have no severity or channel */
+static void OGLCONSOLE_Gutter(_OGLCONSOLE_Console *console, long line,
+                              char *buffer)
+{
+    OGLCONSOLE_Meta *meta = OGLCONSOLE_LineMeta(console, line);
+    int i = line % LINES_PER_PAGE, tagged;
+    char *b = buffer;
+
+    memset(buffer, ' ', console->gutterWidth);
+    if (!meta) return;
+
+    tagged = meta->channel[i] != UNTAGGED;
+
+    if (console->gutter & OGLCONSOLE_GUTTER_TIME)
+    {
+        time_t t = meta->time[i] / 1000000;
+        struct tm *tm = localtime(&t);
+
+        if (tm)
+            sprintf(b, "%02d:%02d:%02d.%03d ", tm->tm_hour, tm->tm_min,
+                    tm->tm_sec, (int)(meta->time[i] / 1000 % 1000));
+        b += 13;
+    }
+
+    if (console->gutter & OGLCONSOLE_GUTTER_SEVERITY)
+    {
+        if (tagged)
+            *b = "TDIWE"[meta->severity[i]];
+        b += 2;
+    }
+
+    if (console->gutter & OGLCONSOLE_GUTTER_CHANNEL)
+    {
+        if (tagged)
+            sprintf(b, "%2d ", meta->channel[i]);
+        b += 3;
+    }
+
+    /* sprintf leaves NULs behind it */
+    for (b = buffer; b < buffer + console->gutterWidth; b++)
+        if (!*b) *b = ' ';
+}
+
+static void OGLCONSOLE_FreeMeta(OGLCONSOLE_Meta *meta)
+{
+    if (!meta) return;
+
+    free(meta->spans);
+    free(meta);
+}
+
+/* The color the current line of output gets painted from column from to
+ * column to (not including it), where the line is length long. Spans inside
+ * that are taken out, and spans are put in at from, and at to for the color
+ * which was there, where the color changes */
+static void OGLCONSOLE_Paint(_OGLCONSOLE_Console *console, int from, int to,
+                             int length, unsigned int color)
+{
+    OGLCONSOLE_Meta *meta;
+    OGLCONSOLE_Span *spans, add[2];
+    int i, j, k, n, count, added = 0;
+    unsigned int before, after;
+
+    if (!(meta = OGLCONSOLE_LineMeta(console, console->lineQueueIndex)))
+        return;
+
+    i = console->lineQueueIndex % LINES_PER_PAGE;
+    spans = meta->spans + meta->spanStart[i];
+    count = meta->spanCount[i];
+
+    /* Nearly always, the color is already right from the last span on */
+    if (count ? from >= spans[count - 1].column
+                && spans[count - 1].color == color
+              : !color)
+        return;
+
+    /* Spans from j to k are inside from to to */
+    for (j = 0; j < count && spans[j].column < from; j++);
+    for (k = j; k < count && spans[k].column < to; k++);
+
+    before = j ? spans[j - 1].color : 0;
+    after = k ? spans[k - 1].color : 0;
+
+    if (before != color)
+    {
+        add[added].column = from;
+        add[added++].color = color;
+    }
+
+    if (to < length && (k == count || spans[k].column != to)
+     && after != color)
+    {
+        add[added].column = to;
+        add[added++].color = after;
+    }
+
+    n = count - (k - j) + added;
+
+    if (meta->spanStart[i] + n > meta->spanSize)
+    {
+        unsigned int size = max(meta->spanSize * 2, meta->spanStart[i] + n);
+        OGLCONSOLE_Span *grown = realloc(meta->spans,
+                max(size, 64) * sizeof(OGLCONSOLE_Span));
+
+        if (!grown) return;
+
+        meta->spans = grown;
+        meta->spanSize = max(size, 64);
+        spans = meta->spans + meta->spanStart[i];
+    }
+
+    memmove(spans + j + added, spans + k,
+            (count - k) * sizeof(OGLCONSOLE_Span));
+    memcpy(spans + j, add, added * sizeof(OGLCONSOLE_Span));
+    meta->spanCount[i] = n;
+}
+
+/* Microseconds since the epoch, for timestamping lines */
+static unsigned long long OGLCONSOLE_Now()
+{
+#ifdef OGLCONSOLE_POSIX
+    struct timespec t;
+
+    if (clock_gettime(CLOCK_REALTIME, &t) == 0)
+        return t.tv_sec * 1000000ull + t.tv_nsec / 1000;
+#endif
+    return time(NULL) * 1000000ull;
+}
+
+#ifdef OGLCONSOLE_POSIX
+/* Make sure at least need bytes of a file are mapped, growing the file and
+ * mapping it afresh if they aren't */
+static int OGLCONSOLE_FileMap(int fd, void *map, size_t *size, size_t need)
+{
+    size_t newSize = *size ? *size : 1 << 16;
+    void *m;
+
+    if (need <= *size) return 1;
+
+    while (newSize < need) newSize *= 2;
+
+    if (ftruncate(fd, newSize)) return 0;
+
+    m = mmap(NULL, newSize, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if (m == MAP_FAILED) return 0;
+
+    if (*(void**)map)
+        munmap(*(void**)map, *size);
+
+    *(void**)map = m;
+    *size = newSize;
+    return 1;
+}
+
+/* Done with a scrollback file; trim off the room we left it to grow into */
+static void OGLCONSOLE_CloseFile(OGLCONSOLE_File *file)
+{
+    if (!file) return;
+
+    if (file->index)
+    {
+        unsigned long long lines = file->index->lines;
+        unsigned long long length = file->index->length;
+
+        munmap(file->index, file->indexSize);
+        if (file->text) munmap(file->text, file->textSize);
+
+        if (ftruncate(file->indexFd, sizeof(OGLCONSOLE_FileIndex)
+                    + (lines - 1) * sizeof(unsigned long long))
+         || ftruncate(file->textFd, length))
+            fprintf(stderr, "OGLCONSOLE: couldn't trim scrollback file\n");
+    }
+
+    if (file->textFd >= 0) close(file->textFd);
+    if (file->indexFd >= 0) close(file->indexFd);
+    free(file);
+}
+
+/* Open (or create) the scrollback file at path, and its index at path.idx.
+ * Nothing is read from the files except the header of the index */
+static OGLCONSOLE_File *OGLCONSOLE_OpenFile(const char *path)
+{
+    OGLCONSOLE_File *file = calloc(1, sizeof(OGLCONSOLE_File));
+    OGLCONSOLE_FileIndex *index;
+    char indexPath[4096];
+    struct stat textStat, indexStat;
+
+    if (!file) return NULL;
+
+    snprintf(indexPath, sizeof(indexPath), "%s.idx", path);
+    file->textFd = open(path, O_RDWR|O_CREAT, 0644);
+    file->indexFd = open(indexPath, O_RDWR|O_CREAT, 0644);
+
+    if (file->textFd < 0 || file->indexFd < 0
+     || fstat(file->textFd, &textStat) || fstat(file->indexFd, &indexStat)
+     || !OGLCONSOLE_FileMap(file->indexFd, &file->index, &file->indexSize,
+                            max(indexStat.st_size, sizeof(OGLCONSOLE_FileIndex)))
+     || !OGLCONSOLE_FileMap(file->textFd, &file->text, &file->textSize,
+                            max(textStat.st_size, 1)))
+    {
+        if (file->index) munmap(file->index, file->indexSize);
+        file->index = NULL;
+        OGLCONSOLE_CloseFile(file);
+        return NULL;
+    }
+
+    index = file->index;
+
+    /* Brand new file */
+    if (indexStat.st_size == 0)
+    {
+        memcpy(index->magic, OGLCONSOLE_FILE_MAGIC, 8);
+        index->lines = 1;
+        index->length = 0;
+        index->start[0] = 0;
+    }
+
+    /* Refuse to touch anything that doesn't look like one of ours */
+    else if (memcmp(index->magic, OGLCONSOLE_FILE_MAGIC, 8)
+          || index->lines < 1
+          || (unsigned long long)indexStat.st_size
+                < sizeof(OGLCONSOLE_FileIndex)
+                + (index->lines - 1) * sizeof(unsigned long long)
+          || index->length > (unsigned long long)textStat.st_size
+          || index->start[index->lines - 1] > index->length)
+    {
+        munmap(file->index, file->indexSize);
+        munmap(file->text, file->textSize);
+        file->index = NULL;
+        OGLCONSOLE_CloseFile(file);
+        return NULL;
+    }
+
+    return file;
+}
+
+/* Length of a line in a scrollback file; all but the last end in a newline,
+ * which doesn't count */
+static int OGLCONSOLE_FileLength(OGLCONSOLE_File *file, long line)
+{
+    OGLCONSOLE_FileIndex *index = file->index;
+
+    if (line + 1 < (long)index->lines)
+        return index->start[line + 1] - index->start[line] - 1;
+
+    return index->length - index->start[line];
+}
+
+static const char *OGLCONSOLE_FileText(OGLCONSOLE_File *file, long line)
+{
+    return file->text + file->index->start[line];
+}
+
+/* Append text to the last line of a scrollback file */
+static int OGLCONSOLE_FileAppend(OGLCONSOLE_File *file, const char *s, int n)
+{
+    if (!OGLCONSOLE_FileMap(file->textFd, &file->text, &file->textSize,
+                            file->index->length + n))
+        return 0;
+
+    memcpy(file->text + file->index->length, s, n);
+    file->index->length += n;
+    return 1;
+}
+
+/* Write over part of the last line of a scrollback file */
+static void OGLCONSOLE_FileOverwrite(OGLCONSOLE_File *file, int column,
+                                     const char *s, int n)
+{
+    memcpy(file->text + file->index->start[file->index->lines - 1] + column,
+           s, n);
+}
+
+/* Cut the last line of a scrollback file short */
+static void OGLCONSOLE_FileTruncate(OGLCONSOLE_File *file, int length)
+{
+    file->index->length = file->index->start[file->index->lines - 1] + length;
+}
+
+/* End the last line of a scrollback file and start another */
+static int OGLCONSOLE_FileNewLine(OGLCONSOLE_File *file)
+{
+    if (!OGLCONSOLE_FileMap(file->indexFd, &file->index, &file->indexSize,
+                sizeof(OGLCONSOLE_FileIndex)
+                + file->index->lines * sizeof(unsigned long long))
+     || !OGLCONSOLE_FileAppend(file, "\n", 1))
+        return 0;
+
+    file->index->start[file->index->lines++] = file->index->length;
+    return 1;
+}
+#else
+#  define OGLCONSOLE_CloseFile(file)
+#  define OGLCONSOLE_FileLength(file, line) 0
+#  define OGLCONSOLE_FileText(file, line) ""
+#  define OGLCONSOLE_FileAppend(file, s, n) 0
+#  define OGLCONSOLE_FileOverwrite(file, column, s, n)
+#  define OGLCONSOLE_FileTruncate(file, length)
+#  define OGLCONSOLE_FileNewLine(file) 0
+#endif
+
+/* Returns the record for scrollback line N, or NULL if there is no such line
+ * (it was never written, or it has already rolled out of the scrollback) */
+static OGLCONSOLE_Line *OGLCONSOLE_GetLine(_OGLCONSOLE_Console *console,
+                                           long line)
+{
+    OGLCONSOLE_Line *page;
+
+    if (line < OGLCONSOLE_FirstLine(console) || line > console->lineQueueIndex)
+        return NULL;
+
+    page = console->pages[(line / LINES_PER_PAGE) % console->pageCount];
+    if (!page) return NULL;
+
+    return page + line % LINES_PER_PAGE;
+}
+
+/* Returns the length of scrollback line N; lines which don't exist are
+ * blank */
+static int OGLCONSOLE_LineLength(_OGLCONSOLE_Console *console, long line)
+{
+    OGLCONSOLE_Line *l;
+
+    if (console->file)
+    {
+        if (line < OGLCONSOLE_FirstLine(console) || line > console->lineQueueIndex)
+            return 0;
+        return OGLCONSOLE_FileLength(console->file, line);
+    }
+
+    l = OGLCONSOLE_GetLine(console, line);
+    return l ? l->length : 0;
+}
+
+/* Returns the text of scrollback line N and stores its length; lines which
+ * don't exist read as blank */
+static const char *OGLCONSOLE_LineText(_OGLCONSOLE_Console *console,
+                                       long line, int *length)
+{
+    OGLCONSOLE_Line *l;
+    const char *text;
+
+    if (console->file)
+    {
+        if (!(*length = OGLCONSOLE_LineLength(console, line)))
+            return "";
+        return OGLCONSOLE_FileText(console->file, line);
+    }
+
+    l = OGLCONSOLE_GetLine(console, line);
+
+    if (!l || !l->block || !(text = OGLCONSOLE_BlockText(l->block)))
+    {
+        *length = 0;
+        return "";
+    }
+
+    *length = l->length;
+    return text + l->offset;
+}
+
+/* How many times a line has been repeated since it was printed */
+static int OGLCONSOLE_Repeats(_OGLCONSOLE_Console *console, long line)
+{
+    OGLCONSOLE_Line *l;
+
+    if (console->file || !(l = OGLCONSOLE_GetLine(console, line)))
+        return 0;
+
+    return l->repeats;
+}
+
+/* Lines which have been repeated are shown with a count on the end */
+#define REPEAT_FORMAT " (x%i)"
+
+/* Returns the text of a line as it's displayed, with its count of repeats if
+ * it has any; that has to be put together in buffer, which needs room for
+ * MAX_LINE_LENGTH plus a few characters */
+static const char *OGLCONSOLE_DisplayText(_OGLCONSOLE_Console *console,
+                                          long line, char *buffer,
+                                          int *length)
+{
+    const char *text = OGLCONSOLE_LineText(console, line, length);
+    int repeats = OGLCONSOLE_Repeats(console, line);
+
+    if (!repeats) return text;
+
+    memcpy(buffer, text, *length);
+    *length += sprintf(buffer + *length, REPEAT_FORMAT, repeats + 1);
+    return buffer;
+}
+
+/* Columns of the display left for lines beside the gutter */
+#define OGLCONSOLE_Columns(console) \
+    max(1, (console)->textWidth - (console)->gutterWidth)
+
+/* Number of rows a line takes up on the display once it's wrapped */
+static int OGLCONSOLE_Rows(_OGLCONSOLE_Console *console, long line)
+{
+    int length = OGLCONSOLE_LineLength(console, line);
+    int repeats = OGLCONSOLE_Repeats(console, line);
+
+    /* Count the digits of the repeat count */
+    if (repeats)
+        for (length += sizeof(REPEAT_FORMAT) - 3, repeats++; repeats;
+             repeats /= 10)
+            length++;
+
+    if (length <= OGLCONSOLE_Columns(console))
+        return 1;
+
+    return (length + OGLCONSOLE_Columns(console) - 1)
+         / OGLCONSOLE_Columns(console);
+}
+
+/* Returns the bloom filter covering line N, or NULL if there is no such line */
+static unsigned char *OGLCONSOLE_Bloom(_OGLCONSOLE_Console *console,
+                                       long line)
+{
+    OGLCONSOLE_Line *l = OGLCONSOLE_GetLine(console, line);
+
+    if (!l) return NULL;
+
+    return (unsigned char*)(l - line % LINES_PER_PAGE + LINES_PER_PAGE)
+         + line % LINES_PER_PAGE / BLOOM_LINES * BLOOM_SIZE;
+}
+
+/* Which bit of a bloom filter stands for the trigram at s */
+static int OGLCONSOLE_Trigram(const char *s)
+{
+    unsigned long t = tolower((unsigned char)s[0]) << 16
+                    | tolower((unsigned char)s[1]) << 8
+                    | tolower((unsigned char)s[2]);
+
+    /* The top bits of a multiplicative hash are the well mixed ones */
+    return ((t * 2654435761ul) & 0xfffffffful) / (0x100000000ull
+                                                  / (BLOOM_SIZE * 8));
+}
+
+/* Add the trigrams of line N which end after its first "from" characters to
+ * its bloom filter; text holds the whole line so far */
+static void OGLCONSOLE_IndexLine(_OGLCONSOLE_Console *console, long line,
+                                 const char *text, int from, int length)
+{
+    unsigned char *bloom = OGLCONSOLE_Bloom(console, line);
+    int i, bit;
+
+    if (!bloom) return;
+
+    for (i = max(from - 2, 0); i + 3 <= length; i++)
+    {
+        bit = OGLCONSOLE_Trigram(text + i);
+        bloom[bit / 8] |= 1 << bit % 8;
+    }
+}
+
+/* Index new text in the current line of output, from position from on. While
+ * the console is hidden nobody can search it, so that waits for the next
+ * search to catch up instead */
+static void OGLCONSOLE_IndexOutput(_OGLCONSOLE_Console *console,
+                                   const char *text, int from, int length)
+{
+    if (console->visible)
+        OGLCONSOLE_IndexLine(console, console->lineQueueIndex,
+                             text, from, length);
+    else if (console->unindexed < 0)
+        console->unindexed = console->lineQueueIndex;
+}
+
+/* Index up to n lines of the output which went by while the console was
+ * hidden. Lines which rolled out of the scrollback meanwhile are never looked
+ * at */
+static void OGLCONSOLE_CatchUpIndex(_OGLCONSOLE_Console *console, long n)
+{
+    const char *text;
+    long line;
+    int length;
+
+    if (console->unindexed < 0) return;
+
+    line = max(console->unindexed, OGLCONSOLE_FirstLine(console));
+
+    if (!console->file)
+        for (; n > 0 && line <= console->lineQueueIndex; n--, line++)
+        {
+            text = OGLCONSOLE_LineText(console, line, &length);
+            OGLCONSOLE_IndexLine(console, line, text, 0, length);
+        }
+
+    console->unindexed = line <= console->lineQueueIndex && !console->file
+                       ? line : -1;
+}
+
+/* Set up the record for a new line at the end of the scrollback. A line record
+ * page is allocated when its first line is written; once the pages[] wheel
+ * comes around, the page it finds there only holds lines which have already
+ * rolled out of the scrollback, so those are let go and the page reused */
+static void OGLCONSOLE_StartLine(_OGLCONSOLE_Console *console, long line)
+{
+    OGLCONSOLE_Line **page, *l;
+    OGLCONSOLE_Meta **meta;
+
+    page = console->pages + (line / LINES_PER_PAGE) % console->pageCount;
+
+    if (line % LINES_PER_PAGE == 0 && *page)
+    {
+        OGLCONSOLE_FreeLines(*page);
+        *page = NULL;
+    }
+
+    if (!*page && !(*page = (OGLCONSOLE_Line*)OGLCONSOLE_AllocPage()))
+        return;
+
+    l = *page + line % LINES_PER_PAGE;
+    l->block = console->block;
+    l->offset = console->block ? console->block->used : 0;
+    l->length = 0;
+    l->repeats = 0;
+
+    if (l->block)
+        l->block->refs++;
+
+    /* Metadata pages stay with their slot of the wheel for good */
+    meta = console->meta + (page - console->pages);
+    if (!*meta && (*meta = malloc(sizeof(OGLCONSOLE_Meta))))
+    {
+        (*meta)->spans = NULL;
+        (*meta)->spanSize = 0;
+    }
+
+    if (*meta)
+    {
+        int i = line % LINES_PER_PAGE;
+
+        /* The line's spans go after the line before's */
+        (*meta)->spanStart[i] = i ? (*meta)->spanStart[i - 1]
+                                  + (*meta)->spanCount[i - 1] : 0;
+        (*meta)->spanCount[i] = 0;
+
+        (*meta)->time[i] = OGLCONSOLE_Now();
+        if (console->outputChannel < 0)
+        {
+            (*meta)->channel[i] = UNTAGGED;
+            (*meta)->severity[i] = OGLCONSOLE_INFO;
+            (*meta)->color[i] = 0;
+        }
+        else
+        {
+            (*meta)->channel[i] = console->outputChannel;
+            (*meta)->severity[i] = console->outputSeverity;
+            (*meta)->color[i] =
+                OGLCONSOLE_severityColors[console->outputSeverity];
+        }
+    }
+}
+
+/* Advance output to a new line */
+static void OGLCONSOLE_NewLine(_OGLCONSOLE_Console *console)
+{
+    console->outputColumn = 0;
+
+    if (console->file)
+    {
+        if (OGLCONSOLE_FileNewLine(console->file))
+            console->lineQueueIndex++;
+        return;
+    }
+
+    OGLCONSOLE_StartLine(console, ++console->lineQueueIndex);
+}
+
+/* Take back the current line of output, leaving output at the end of the line
+ * before it. The current line is always the last thing in its block */
+static void OGLCONSOLE_DropLine(_OGLCONSOLE_Console *console)
+{
+    OGLCONSOLE_Line *l = OGLCONSOLE_GetLine(console, console->lineQueueIndex);
+
+    if (!l || console->lineQueueIndex == 0) return;
+
+    if (l->block)
+    {
+        l->block->used = l->offset;
+        OGLCONSOLE_ReleaseBlock(l->block);
+        l->block = NULL;
+    }
+
+    console->lineQueueIndex--;
+}
+
+/* Hash for spotting repeated lines (32 bit FNV-1a) */
+static unsigned long OGLCONSOLE_Hash(const char *s, int n)
+{
+    unsigned long h = 2166136261ul;
+
+    while (n--)
+        h = ((h ^ (unsigned char)*s++) * 16777619ul) & 0xfffffffful;
+
+    return h;
+}
+
+/* If the current line of output is the same as one of the last few lines, we
+ * count a repeat of that line and drop this one, returning 1. Comparing hashes
+ * rules out nearly every line which isn't a repeat */
+static int OGLCONSOLE_Coalesce(_OGLCONSOLE_Console *console)
+{
+    long line = console->lineQueueIndex;
+    OGLCONSOLE_Line *l = OGLCONSOLE_GetLine(console, line), *r;
+    const char *text, *repeated;
+    unsigned long hash;
+    int i, slot, length;
+
+    if (!console->coalesce || console->file || !l || !l->block || !l->length)
+        return 0;
+
+    text = l->block->text + l->offset;
+    hash = OGLCONSOLE_Hash(text, l->length);
+
+    /* Look back from the most recent line */
+    for (i = 1; i <= console->coalesce; i++)
+    {
+        slot = (console->recentNext - i + COALESCE_WINDOW) % COALESCE_WINDOW;
+
+        if (console->recentHash[slot] != hash
+         || !(r = OGLCONSOLE_GetLine(console, console->recentLine[slot]))
+         || r->length != l->length || r->repeats == 0xffff)
+            continue;
+
+        repeated = OGLCONSOLE_LineText(console, console->recentLine[slot],
+                                       &length);
+        if (memcmp(repeated, text, length))
+            continue;
+
+        r->repeats++;
+        OGLCONSOLE_DropLine(console);
+        return 1;
+    }
+
+    slot = console->recentNext;
+    console->recentHash[slot] = hash;
+    console->recentLine[slot] = line;
+    console->recentNext = (slot + 1) % COALESCE_WINDOW;
+    return 0;
+}
+
+/* Index of the first line listed in a view which comes after line N */
+static long OGLCONSOLE_ViewAfter(OGLCONSOLE_View *view, long line)
+{
+    long lo = view->start, hi = view->count;
+
+    while (lo < hi)
+    {
+        long mid = lo + (hi - lo) / 2;
+
+        if (view->lines[mid] > line)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+
+    return lo;
+}
+
+/* The last line shown at or before line N; without a view, every line is
+ * shown. Returns -1 if there isn't one */
+static long OGLCONSOLE_ShownBy(_OGLCONSOLE_Console *console, long line)
+{
+    long i;
+
+    if (!console->view) return line;
+
+    i = OGLCONSOLE_ViewAfter(console->view, line) - 1;
+    return i >= console->view->start ? console->view->lines[i] : -1;
+}
+
+/* The first line shown after line N, or one past the last line if none is */
+static long OGLCONSOLE_ShownAfter(_OGLCONSOLE_Console *console, long line)
+{
+    long i;
+
+    if (!console->view) return line + 1;
+
+    i = OGLCONSOLE_ViewAfter(console->view, line);
+    return i < console->view->count ? console->view->lines[i]
+                                    : console->lineQueueIndex + 1;
+}
+
+/* The newest line shown, which is where the display follows new output */
+static long OGLCONSOLE_LastShown(_OGLCONSOLE_Console *console)
+{
+    return OGLCONSOLE_ShownBy(console, console->lineQueueIndex);
+}
+
+#define OGLCONSOLE_Shown(console, line) \
+    (OGLCONSOLE_ShownBy(console, line) == (line))
+
+/* Whether line N's metadata passes a view's filter. Untagged lines count as
+ * OGLCONSOLE_INFO, on any channel */
+static int OGLCONSOLE_ViewWants(OGLCONSOLE_View *view, long line)
+{
+    OGLCONSOLE_Meta *meta = OGLCONSOLE_LineMeta((void*)view->console, line);
+    int i = line % LINES_PER_PAGE, severity = OGLCONSOLE_INFO;
+
+    if (meta && meta->channel[i] != UNTAGGED)
+    {
+        if (meta->channel[i] >= OGLCONSOLE_CHANNELS
+         || !(view->channels & 1ul << meta->channel[i]))
+            return 0;
+        severity = meta->severity[i];
+    }
+
+    return severity >= view->minSeverity;
+}
+
+/* Whether NUL terminated text matches a view's expression; without one,
+ * everything does */
+static int OGLCONSOLE_ViewMatches(OGLCONSOLE_View *view, const char *text)
+{
+    if (!view->pattern) return 1;
+
+#ifdef OGLCONSOLE_POSIX
+    return regexec(&view->regex, text, 0, NULL, 0) == 0;
+#else
+    return strstr(text, view->pattern) != NULL;
+#endif
+}
+
+/* Add line N to the end of a view's list, letting go of lines at the front
+ * which have rolled out of the scrollback */
+static void OGLCONSOLE_ViewAdd(OGLCONSOLE_View *view, long line)
+{
+    _OGLCONSOLE_Console *console = (void*)view->console;
+    long first = OGLCONSOLE_FirstLine(console);
+
+    while (view->start < view->count && view->lines[view->start] < first)
+        view->start++;
+
+    if (view->count == view->size)
+    {
+        if (view->start >= view->size / 2 && view->start > 0)
+        {
+            memmove(view->lines, view->lines + view->start,
+                    (view->count - view->start) * sizeof(long));
+            view->count -= view->start;
+            view->start = 0;
+        }
+        else
+        {
+            long size = view->size ? view->size * 2 : 256;
+            long *lines = realloc(view->lines, size * sizeof(long));
+
+            if (!lines) return;
+
+            view->lines = lines;
+            view->size = size;
+        }
+    }
+
+    view->lines[view->count++] = line;
+}
+
+/* A line of output is finished; list it in the console's views if it matches
+ * them. Lines are tested only this once, and their text is only looked at if
+ * their metadata passes */
+static void OGLCONSOLE_CommitLine(_OGLCONSOLE_Console *console)
+{
+    static char text[MAX_LINE_LENGTH + 1];
+    OGLCONSOLE_View *view = console->view, *pending = console->pendingView;
+    long line = console->lineQueueIndex;
+    const char *s;
+    int length;
+
+    if (view && !OGLCONSOLE_ViewWants(view, line)) view = NULL;
+    if (pending && !OGLCONSOLE_ViewWants(pending, line)) pending = NULL;
+
+    if (!view && !pending) return;
+
+    if ((view && view->pattern) || (pending && pending->pattern))
+    {
+        s = OGLCONSOLE_LineText(console, line, &length);
+        memcpy(text, s, length);
+        text[length] = '\0';
+    }
+
+    if (view && OGLCONSOLE_ViewMatches(view, text))
+        OGLCONSOLE_ViewAdd(view, line);
+
+    if (pending && OGLCONSOLE_ViewMatches(pending, text))
+        OGLCONSOLE_ViewAdd(pending, line);
+}
+
+/* The current line of output is complete */
+static void OGLCONSOLE_EndLine(_OGLCONSOLE_Console *console)
+{
+    if (!OGLCONSOLE_Coalesce(console))
+        OGLCONSOLE_CommitLine(console);
+}
+
+/* Copy the text of line N into buffer, NUL terminated, and return its length.
+ * This runs on scan workers with storage locked, so it mustn't touch the
+ * unpacked block cache; cold blocks get unpacked into unpacked instead, which
+ * remembers the last block it held in *holding */
+static int OGLCONSOLE_CopyLine(_OGLCONSOLE_Console *console, long line,
+                               char *buffer, char *unpacked,
+                               OGLCONSOLE_Block **holding)
+{
+    OGLCONSOLE_Line *l;
+    OGLCONSOLE_Block *block;
+    const char *text = NULL;
+    int length = 0;
+
+    if (console->file)
+    {
+        if ((length = OGLCONSOLE_LineLength(console, line)))
+            text = OGLCONSOLE_FileText(console->file, line);
+    }
+    else if ((l = OGLCONSOLE_GetLine(console, line)) && (block = l->block))
+    {
+        if (block->text)
+            text = block->text;
+        else
+        {
+            if (*holding != block)
+                *holding = OGLCONSOLE_Unpack((unsigned char*)block->packed,
+                                             block->packedSize,
+                                             (unsigned char*)unpacked,
+                                             OGLCONSOLE_PAGE_SIZE)
+                        == block->used ? block : NULL;
+
+            if (*holding == block)
+                text = unpacked;
+        }
+
+        if (text)
+        {
+            text += l->offset;
+            length = l->length;
+        }
+    }
+
+    if (length) memcpy(buffer, text, length);
+    buffer[length] = '\0';
+    return length;
+}
+
+/* A scan worker takes lines from a view's scan a bunch at a time, copying them
+ * out of the scrollback with storage locked, and then matches them while
+ * nothing's locked */
+static int OGLCONSOLE_ScanThread(void *data)
+{
+    OGLCONSOLE_View *view = data;
+    OGLCONSOLE_Console console = view->console;
+    char *buffer = malloc(SCAN_BYTES), *unpacked = malloc(OGLCONSOLE_PAGE_SIZE);
+    int offset[SCAN_LINES], match[SCAN_LINES];
+    long line, from = 0;
+    int i, n = 0, used;
+
+    OGLCONSOLE_LockStorage();
+
+    while (buffer && unpacked && !view->cancel)
+    {
+        OGLCONSOLE_Block *holding = NULL;
+
+        /* Mark what matched last time around */
+        for (i = 0; i < n; i++)
+            if (match[i])
+            {
+                line = from + i - view->scanFirst;
+                view->hits[line / 8] |= 1 << line % 8;
+            }
+
+        if (view->scanNext > view->scanLast) break;
+
+        /* Text is only copied for lines whose metadata passes, and only if
+         * there's an expression to match it against */
+        from = line = view->scanNext;
+        for (n = used = 0; n < SCAN_LINES && line <= view->scanLast
+                        && used + MAX_LINE_LENGTH < SCAN_BYTES; n++, line++)
+        {
+            offset[n] = used;
+            if ((match[n] = OGLCONSOLE_ViewWants(view, line)) && view->pattern)
+                used += OGLCONSOLE_CopyLine(C, line, buffer + used, unpacked,
+                                            &holding) + 1;
+        }
+        view->scanNext = line;
+
+        OGLCONSOLE_UnlockStorage();
+
+        for (i = 0; i < n; i++)
+            if (match[i])
+                match[i] = OGLCONSOLE_ViewMatches(view, buffer + offset[i]);
+
+        OGLCONSOLE_LockStorage();
+    }
+
+    view->workers--;
+    OGLCONSOLE_UnlockStorage();
+
+    free(buffer);
+    free(unpacked);
+    return 0;
+}
+
+/* Make a view for an expression (or NULL for none) and the console's filter
+ * on metadata, and start scanning the scrollback for it. Returns NULL if the
+ * expression is no good */
+static OGLCONSOLE_View *OGLCONSOLE_StartView(_OGLCONSOLE_Console *console,
+                                            const char *pattern)
+{
+    OGLCONSOLE_View *view = calloc(1, sizeof(OGLCONSOLE_View));
+    int i, threads = 1;
+
+    if (!view) return NULL;
+
+    view->minSeverity = console->shownSeverity;
+    view->channels = console->shownChannels;
+
+    if (pattern && !(view->pattern = strdup(pattern)))
+    {
+        free(view);
+        return NULL;
+    }
+
+#ifdef OGLCONSOLE_POSIX
+    if (pattern && regcomp(&view->regex, pattern, REG_EXTENDED | REG_NOSUB))
+    {
+        free(view->pattern);
+        free(view);
+        return NULL;
+    }
+
+    threads = max(1, min(sysconf(_SC_NPROCESSORS_ONLN), MAX_SCAN_THREADS));
+#endif
+
+    /* Lines still being output to haven't been finished yet; they're tested
+     * when they are */
+    view->console = (void*)console;
+    view->scanFirst = view->scanNext = OGLCONSOLE_FirstLine(console);
+    view->scanLast = console->lineQueueIndex - !console->outputNewline;
+
+    if (view->scanLast < view->scanFirst) return view;
+
+    view->hits = calloc((view->scanLast - view->scanFirst) / 8 + 1, 1);
+    if (!view->hits) return view;
+
+    view->workers = threads;
+
+#ifdef OGLCONSOLE_THREADS
+    if (!OGLCONSOLE_storageLock)
+        OGLCONSOLE_storageLock = SDL_CreateMutex();
+
+    for (i = 0; OGLCONSOLE_storageLock && i < threads; i++)
+    {
+        if (!(view->threads[i] = SDL_CreateThread(OGLCONSOLE_ScanThread,
+                                                  view)))
+            break;
+        view->threadCount++;
+    }
+
+    OGLCONSOLE_LockStorage();
+    view->workers -= threads - view->threadCount;
+    OGLCONSOLE_UnlockStorage();
+
+    if (view->threadCount) return view;
+    view->workers = 1;
+#endif
+
+    /* Without threads, we just do the scan now */
+    OGLCONSOLE_ScanThread(view);
+    return view;
+}
+
+/* Wait for a view's workers to finish, stopping them early if cancel is set */
+static void OGLCONSOLE_StopView(OGLCONSOLE_View *view, int cancel)
+{
+#ifdef OGLCONSOLE_THREADS
+    int i;
+
+    OGLCONSOLE_LockStorage();
+    view->cancel = cancel;
+    OGLCONSOLE_UnlockStorage();
+
+    for (i = 0; i < view->threadCount; i++)
+        SDL_WaitThread(view->threads[i], NULL);
+    view->threadCount = 0;
+#endif
+}
+
+static void OGLCONSOLE_FreeView(OGLCONSOLE_View *view)
+{
+    if (!view) return;
+
+    OGLCONSOLE_StopView(view, 1);
+
+#ifdef OGLCONSOLE_POSIX
+    if (view->pattern)
+        regfree(&view->regex);
+#endif
+    free(view->pattern);
+    free(view->hits);
+    free(view->lines);
+    free(view);
+}
+
+/* Scroll the display straight to a line, the whole of it showing, stopping
+ * any smooth scrolling under way */
+static void OGLCONSOLE_ScrollTo(_OGLCONSOLE_Console *console, long line)
+{
+    console->lineScrollIndex = line;
+    console->rowScrollIndex = 0;
+    console->scrollFraction = console->scrollAhead = 0;
+    console->scrollVelocity = 0;
+}
+
+/* Once a console's pending view has been scanned, list the lines which
+ * matched ahead of those output since, and show it in place of the old view */
+static void OGLCONSOLE_CollectView(_OGLCONSOLE_Console *console)
+{
+    OGLCONSOLE_View *view = console->pendingView;
+    long line, n, first = OGLCONSOLE_FirstLine(console), *lines;
+    int busy;
+
+    if (!view) return;
+
+    OGLCONSOLE_LockStorage();
+    busy = view->workers;
+    OGLCONSOLE_UnlockStorage();
+
+    if (busy) return;
+
+    OGLCONSOLE_StopView(view, 0);
+
+    if (view->hits)
+    {
+        for (n = 0, line = view->scanFirst; line <= view->scanLast; line++)
+            if (view->hits[(line - view->scanFirst) / 8]
+                    & 1 << (line - view->scanFirst) % 8)
+                n++;
+
+        if (!(lines = malloc((n + view->count - view->start + 1)
+                             * sizeof(long))))
+            return;
+
+        for (n = 0, line = view->scanFirst; line <= view->scanLast; line++)
+            if (view->hits[(line - view->scanFirst) / 8]
+                    & 1 << (line - view->scanFirst) % 8 && line >= first)
+                lines[n++] = line;
+
+        if (view->count > view->start)
+            memcpy(lines + n, view->lines + view->start,
+                   (view->count - view->start) * sizeof(long));
+
+        free(view->lines);
+        free(view->hits);
+        view->hits = NULL;
+        view->lines = lines;
+        view->count = n + view->count - view->start;
+        view->start = 0;
+        view->size = view->count + 1;
+    }
+
+    OGLCONSOLE_FreeView(console->view);
+    console->view = view;
+    console->pendingView = NULL;
+
+    /* Show the newest of the lines */
+    OGLCONSOLE_ScrollTo(console, OGLCONSOLE_LastShown(console));
+}
+
+/* The current line of output always sits at the end of the console's block.
+ * When it outgrows the space left there, it moves to a new block */
+static int OGLCONSOLE_MoveLine(_OGLCONSOLE_Console *console,
+                               OGLCONSOLE_Line *l)
+{
+    OGLCONSOLE_Block *block = OGLCONSOLE_NewBlock();
+
+    if (!block) return 0;
+
+    if (l->block)
+    {
+        memcpy(block->text, l->block->text + l->offset, l->length);
+        OGLCONSOLE_ReleaseBlock(l->block);
+    }
+
+    OGLCONSOLE_SealBlock(console->block);
+    OGLCONSOLE_ReleaseBlock(console->block);
+    console->block = block;
+
+    block->used = l->length;
+    block->refs++;
+    l->block = block;
+    l->offset = 0;
+    return 1;
+}
+
+/* Append some text to the current line of output in memory */
+static int OGLCONSOLE_AppendToBlock(_OGLCONSOLE_Console *console,
+                                   const char *s, int n)
+{
+    OGLCONSOLE_Line *l = OGLCONSOLE_GetLine(console, console->lineQueueIndex);
+
+    if (!l) return 0;
+
+    if ((!l->block || l->offset + l->length + n > OGLCONSOLE_PAGE_SIZE)
+     && !OGLCONSOLE_MoveLine(console, l))
+        return 0;
+
+    memcpy(l->block->text + l->offset + l->length, s, n);
+    l->length += n;
+    l->block->used = l->offset + l->length;
+
+    OGLCONSOLE_IndexOutput(console, l->block->text + l->offset,
+                           l->length - n, l->length);
+    return 1;
+}
+
+/* Write over part of the current line of output, from column on */
+static void OGLCONSOLE_Overwrite(_OGLCONSOLE_Console *console, int column,
+                                 const char *s, int n)
+{
+    OGLCONSOLE_Line *l;
+
+    if (console->file)
+    {
+        OGLCONSOLE_FileOverwrite(console->file, column, s, n);
+        return;
+    }
+
+    if (!(l = OGLCONSOLE_GetLine(console, console->lineQueueIndex))
+     || !l->block)
+        return;
+
+    memcpy(l->block->text + l->offset + column, s, n);
+
+    /* Trigrams running into what was there already are new too */
+    OGLCONSOLE_IndexOutput(console, l->block->text + l->offset, column,
+                           min(column + n + 2, l->length));
+}
+
+/* Cut the current line of output back to nothing */
+static void OGLCONSOLE_Truncate(_OGLCONSOLE_Console *console)
+{
+    OGLCONSOLE_Line *l;
+
+    console->outputColumn = 0;
+
+    if (console->file)
+        OGLCONSOLE_FileTruncate(console->file, 0);
+    else if ((l = OGLCONSOLE_GetLine(console, console->lineQueueIndex)))
+    {
+        OGLCONSOLE_Meta *meta = OGLCONSOLE_LineMeta(console,
+                                                    console->lineQueueIndex);
+
+        l->length = 0;
+        if (l->block)
+            l->block->used = l->offset;
+
+        if (meta)
+            meta->spanCount[console->lineQueueIndex % LINES_PER_PAGE] = 0;
+    }
+}
+
+/* Put some text into the current line of output at the output column, over
+ * what's there and then on the end, in color (0 being the line's own) */
+static void OGLCONSOLE_AppendColored(_OGLCONSOLE_Console *console,
+                                     const char *s, int n, unsigned int color)
+{
+    while (n > 0)
+    {
+        int k, length = OGLCONSOLE_LineLength(console, console->lineQueueIndex);
+
+        /* Break very long lines */
+        if (console->outputColumn >= MAX_LINE_LENGTH)
+        {
+            OGLCONSOLE_CommitLine(console);
+            OGLCONSOLE_NewLine(console);
+            continue;
+        }
+
+        if (console->outputColumn < length)
+        {
+            k = min(n, length - console->outputColumn);
+            OGLCONSOLE_Overwrite(console, console->outputColumn, s, k);
+        }
+        else
+        {
+            k = min(n, MAX_LINE_LENGTH - length);
+
+            if (console->file ? !OGLCONSOLE_FileAppend(console->file, s, k)
+                              : !OGLCONSOLE_AppendToBlock(console, s, k))
+                return;
+        }
+
+        OGLCONSOLE_Paint(console, console->outputColumn,
+                         console->outputColumn + k, length, color);
+
+        console->outputColumn += k;
+        s += k;
+        n -= k;
+    }
+}
+
+/* Put some text into the current line of output in the color which color
+ * codes in the output have set */
+static void OGLCONSOLE_Append(_OGLCONSOLE_Console *console,
+                              const char *s, int n)
+{
+    OGLCONSOLE_AppendColored(console, s, n, console->quakeColor
+                                            ? console->quakeColor
+                                            : console->ansiColor);
+}
+
+/* Resize the pages[] wheel so it can hold maxLines lines. Pages still holding
+ * scrollback move to their new slots; their contents are never copied */
+static void OGLCONSOLE_ResizeScrollback(_OGLCONSOLE_Console *console,
+                                        int maxLines)
+{
+    int pageCount = (maxLines + LINES_PER_PAGE - 1) / LINES_PER_PAGE + 1;
+    OGLCONSOLE_Line **pages = calloc(pageCount, sizeof(OGLCONSOLE_Line*));
+    OGLCONSOLE_Meta **meta = calloc(pageCount, sizeof(OGLCONSOLE_Meta*));
+    long p, first, last;
+
+    if (!pages || !meta)
+    {
+        free(pages);
+        free(meta);
+        return;
+    }
+
+    /* Pages holding the last maxLines lines survive */
+    last = console->lineQueueIndex / LINES_PER_PAGE;
+    first = (console->lineQueueIndex - maxLines + 1) / LINES_PER_PAGE;
+    if (first < 0) first = 0;
+
+    if (console->pages)
+    {
+        for (p = 0; p < console->pageCount; p++)
+        {
+            long n = last - (last - p + console->pageCount)
+                          % console->pageCount;
+
+            if (n >= first && n <= last)
+            {
+                pages[n % pageCount] = console->pages[p];
+                meta[n % pageCount] = console->meta[p];
+            }
+            else
+            {
+                OGLCONSOLE_FreeLines(console->pages[p]);
+                OGLCONSOLE_FreeMeta(console->meta[p]);
+            }
+        }
+
+        free(console->pages);
+        free(console->meta);
+    }
+
+    console->pages = pages;
+    console->meta = meta;
+    console->pageCount = pageCount;
+    console->maxLines = maxLines;
+}
+
+/* Whether line N contains text (of length n), ignoring case */
+static int OGLCONSOLE_LineContains(_OGLCONSOLE_Console *console, long line,
+                                   const char *text, int n)
+{
+    int i, j, length;
+    const char *s = OGLCONSOLE_LineText(console, line, &length);
+
+    for (i = 0; i + n <= length; i++)
+    {
+        for (j = 0; j < n; j++)
+            if (tolower((unsigned char)s[i + j])
+             != tolower((unsigned char)text[j]))
+                break;
+
+        if (j == n) return 1;
+    }
+
+    return 0;
+}
+
+/* Whether any line in the same run of BLOOM_LINES as line N might contain
+ * text. Scrollback kept in a file has no blooms, so it all might */
+static int OGLCONSOLE_MightContain(_OGLCONSOLE_Console *console, long line,
+                                   const char *text, int n)
+{
+    unsigned char *bloom;
+    int i, bit;
+
+    if (console->file || !(bloom = OGLCONSOLE_Bloom(console, line)))
+        return 1;
+
+    for (i = 0; i + 3 <= n; i++)
+    {
+        bit = OGLCONSOLE_Trigram(text + i);
+        if (!(bloom[bit / 8] & 1 << bit % 8))
+            return 0;
+    }
+
+    return 1;
+}
+
+/* Find the nearest line to line N, going in direction (1 or -1) and starting
+ * with N itself, which contains text. Whole runs of lines are skipped when
+ * their bloom rules them out. Returns -1 if there's no such line */
+static long OGLCONSOLE_FindLine(_OGLCONSOLE_Console *console,
+                                const char *text, long line, int direction)
+{
+    long first = OGLCONSOLE_FirstLine(console);
+    int n = strlen(text);
+
+    if (!n) return -1;
+
+    OGLCONSOLE_CatchUpIndex(console, console->lineQueueIndex + 1);
+
+    for (; line >= first && line <= console->lineQueueIndex; line += direction)
+    {
+        if (!OGLCONSOLE_MightContain(console, line, text, n))
+        {
+            /* Go on from the far end of this run */
+            if (direction < 0)
+                line -= line % BLOOM_LINES;
+            else
+                line |= BLOOM_LINES - 1;
+            continue;
+        }
+
+        if (OGLCONSOLE_LineContains(console, line, text, n)
+         && OGLCONSOLE_Shown(console, line))
+            return line;
+    }
+
+    return -1;
+}
+
+/* Scroll the console display by some number of rows; negative numbers scroll
+ * back toward older output. Scrolling stops at the oldest line in the
+ * scrollback and at the newest line of output, and skips lines which aren't
+ * shown. Returns the rows it couldn't scroll by for reaching the end */
+static long OGLCONSOLE_ScrollBy(_OGLCONSOLE_Console *console, long rows)
+{
+    long line, first = OGLCONSOLE_FirstLine(console),
+         last = OGLCONSOLE_LastShown(console);
+
+    /* The line we were scrolled to may have rolled out of the scrollback, or
+     * a view may have come along which doesn't show it */
+    if (console->lineScrollIndex < first
+     || !OGLCONSOLE_Shown(console, console->lineScrollIndex))
+    {
+        line = max(console->lineScrollIndex, first) - 1;
+        console->lineScrollIndex = min(OGLCONSOLE_ShownAfter(console, line),
+                                       last);
+        console->rowScrollIndex = 0;
+    }
+
+    /* Or it may have fewer rows than it did when we scrolled to it */
+    if (console->rowScrollIndex >=
+            OGLCONSOLE_Rows(console, console->lineScrollIndex))
+        console->rowScrollIndex =
+            OGLCONSOLE_Rows(console, console->lineScrollIndex) - 1;
+
+    for (; rows < 0; rows++)
+    {
+        if (console->rowScrollIndex + 1 <
+                OGLCONSOLE_Rows(console, console->lineScrollIndex))
+            console->rowScrollIndex++;
+        else if ((line = OGLCONSOLE_ShownBy(console,
+                        console->lineScrollIndex - 1)) >= first)
+        {
+            console->lineScrollIndex = line;
+            console->rowScrollIndex = 0;
+        }
+        else break;
+    }
+
+    for (; rows > 0; rows--)
+    {
+        if (console->rowScrollIndex > 0)
+            console->rowScrollIndex--;
+        else if (console->lineScrollIndex < last)
+        {
+            console->lineScrollIndex =
+                OGLCONSOLE_ShownAfter(console, console->lineScrollIndex);
+            console->rowScrollIndex =
+                OGLCONSOLE_Rows(console, console->lineScrollIndex) - 1;
+        }
+        else break;
+    }
+
+    return rows;
+}
+
+/* Scroll the display by rows and a fraction of one, the fraction showing as
+ * the display shifted down by part of a row. Returns 0 if it ran into the
+ * oldest or newest row */
+static int OGLCONSOLE_ScrollFraction(_OGLCONSOLE_Console *console,
+                                     double rows)
+{
+    double back = console->scrollFraction - rows, whole = floor(back + 1e-6);
+
+    console->scrollFraction = back - whole < 1e-6 ? 0 : back - whole;
+
+    if (OGLCONSOLE_ScrollBy(console, -(long)whole))
+    {
+        console->scrollFraction = 0;
+        return 0;
+    }
+
+    /* There's nothing to show part of past the oldest row */
+    if (console->scrollFraction
+     && console->rowScrollIndex + 1 >=
+            OGLCONSOLE_Rows(console, console->lineScrollIndex)
+     && OGLCONSOLE_ShownBy(console, console->lineScrollIndex - 1)
+            < OGLCONSOLE_FirstLine(console))
+    {
+        console->scrollFraction = 0;
+        return 0;
+    }
+
+    return 1;
+}
+
+/* Scroll the display smoothly by some number of rows, on from wherever it's
+ * headed already. Keys glide it there; the mouse wheel flings it, to coast
+ * about that far */
+static void OGLCONSOLE_GlideBy(_OGLCONSOLE_Console *console, long rows,
+                               int fling)
+{
+#ifdef OGLCONSOLE_SLIDE
+    if (!console->scrollAhead && !console->scrollVelocity)
+        console->scrollTicks = SDL_GetTicks();
+
+    if (!fling)
+        console->scrollAhead += rows;
+    else
+    {
+        /* Turning the wheel the other way stops it first */
+        if (console->scrollVelocity * rows < 0)
+            console->scrollVelocity = 0;
+
+        console->scrollVelocity += rows * FLING_FRICTION;
+    }
+#else
+    OGLCONSOLE_ScrollBy(console, rows);
+#endif
+}
+
+/* Move the display on as far as its smooth scrolling has got by now, coming
+ * to rest on a whole row */
+static void OGLCONSOLE_Glide(_OGLCONSOLE_Console *console)
+{
+#ifdef OGLCONSOLE_SLIDE
+    unsigned int now = SDL_GetTicks();
+    double dt = min(now - console->scrollTicks, 100) / 1000.0, rows, f;
+
+    if (!console->scrollAhead && !console->scrollVelocity) return;
+    console->scrollTicks = now;
+
+    /* A fling coasts, slowing down */
+    f = exp(-FLING_FRICTION * dt);
+    rows = console->scrollVelocity * (1 - f) / FLING_FRICTION;
+    console->scrollVelocity *= f;
+    if (fabs(console->scrollVelocity) < 1)
+        console->scrollVelocity = 0;
+
+    /* A glide covers most of the rest of the way in GLIDE_MS */
+    f = console->scrollAhead * exp(-3000 * dt / GLIDE_MS);
+    if (fabs(f) < 1 / 32.0) f = 0;
+    rows += console->scrollAhead - f;
+    console->scrollAhead = f;
+
+    if (!OGLCONSOLE_ScrollFraction(console, rows))
+        console->scrollAhead = console->scrollVelocity = 0;
+
+    if (!console->scrollAhead && !console->scrollVelocity
+     && console->scrollFraction)
+        console->scrollAhead = console->scrollFraction < 0.5
+                             ? console->scrollFraction
+                             : console->scrollFraction - 1;
+#endif
+}
+
+#ifdef OGLCONSOLE_POSIX
+/* Write some pieces of text to a file descriptor in one go if we can, picking
+ * up where we left off after short writes */
+static void OGLCONSOLE_WriteAll(int fd, struct iovec *iov, int iovcnt)
+{
+    ssize_t r;
+
+    while (iovcnt && (r = writev(fd, iov, iovcnt)) > 0)
+    {
+        while (iovcnt && r >= (ssize_t)iov->iov_len)
+        {
+            r -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+
+        if (iovcnt)
+        {
+            iov->iov_base = (char*)iov->iov_base + r;
+            iov->iov_len -= r;
+        }
+    }
+}
+#endif
+
+/* Write whatever is waiting in a console's sink buffer out to its sinks.
+ * Only the writer thread calls this, unless there are no threads */
+static void OGLCONSOLE_FlushSinks(_OGLCONSOLE_Console *console)
+{
+    unsigned long tail = console->sinkTail, head = console->sinkHead;
+    unsigned long start = tail & (SINK_BUFFER_SIZE - 1);
+    const char *piece[2];
+    int length[2], pieces, i, j;
+
+    OGLCONSOLE_BARRIER();
+
+    if (head == tail) return;
+
+    /* The buffer wraps, so the waiting output may be in two pieces */
+    piece[0] = console->sinkBuffer + start;
+    length[0] = min(head - tail, SINK_BUFFER_SIZE - start);
+    piece[1] = console->sinkBuffer;
+    length[1] = head - tail - length[0];
+    pieces = length[1] ? 2 : 1;
+
+    for (i = 0; i < console->sinkCount; i++)
+    {
+        OGLCONSOLE_Sink *sink = console->sinks + i;
+
+        if (sink->callback)
+        {
+            for (j = 0; j < pieces; j++)
+                sink->callback((OGLCONSOLE_Console)console, piece[j],
+                               length[j], sink->data);
+        }
+#ifdef OGLCONSOLE_POSIX
+        else
+        {
+            struct iovec iov[2];
+
+            for (j = 0; j < pieces; j++)
+            {
+                iov[j].iov_base = (void*)piece[j];
+                iov[j].iov_len = length[j];
+            }
+
+            OGLCONSOLE_WriteAll(sink->fd, iov, pieces);
+        }
+#endif
+    }
+
+    /* Let the console have the space back */
+    OGLCONSOLE_BARRIER();
+    console->sinkTail = head;
+}
+
+#ifdef OGLCONSOLE_THREADS
+/* Each console with sinks has a writer thread, which sleeps until there's
+ * output for it and then writes out everything that has piled up */
+static int OGLCONSOLE_SinkThread(void *console)
+{
+    while (!C->sinkQuit || C->sinkHead != C->sinkTail)
+    {
+        SDL_SemWaitTimeout(C->sinkWork, 100);
+        OGLCONSOLE_FlushSinks(C);
+    }
+
+    return 0;
+}
+#endif
+
+/* Copy some output into a console's sink buffer for the writer thread. This
+ * never waits for the sinks themselves; when the buffer is full, the output
+ * is either dropped (and counted) or we wait for the writer to make room */
+static void OGLCONSOLE_SinkOutput(_OGLCONSOLE_Console *console,
+                                  const char *s, int n)
+{
+    unsigned long head = console->sinkHead, start;
+    int k;
+
+    if (!console->sinkCount || n <= 0) return;
+
+    /* A backlog put in all at once can be more than the buffer holds, so
+     * that goes a piece at a time */
+    for (; n > SINK_BUFFER_SIZE / 2; s += k, n -= k)
+    {
+        k = SINK_BUFFER_SIZE / 2;
+        OGLCONSOLE_SinkOutput(console, s, k);
+        head = console->sinkHead;
+    }
+
+    while (SINK_BUFFER_SIZE - (head - console->sinkTail) < (unsigned long)n)
+    {
+#ifdef OGLCONSOLE_THREADS
+        if (console->sinkBlock && n <= SINK_BUFFER_SIZE && console->sinkThread)
+        {
+            SDL_SemPost(console->sinkWork);
+            SDL_Delay(1);
+            continue;
+        }
+#else
+        if (console->sinkBlock && n <= SINK_BUFFER_SIZE)
+        {
+            OGLCONSOLE_FlushSinks(console);
+            continue;
+        }
+#endif
+        console->sinkDropped += n;
+        return;
+    }
+
+    OGLCONSOLE_BARRIER();
+
+    start = head & (SINK_BUFFER_SIZE - 1);
+    k = min((unsigned long)n, SINK_BUFFER_SIZE - start);
+    memcpy(console->sinkBuffer + start, s, k);
+    memcpy(console->sinkBuffer, s + k, n - k);
+
+    OGLCONSOLE_BARRIER();
+    console->sinkHead = head + n;
+
+#ifdef OGLCONSOLE_THREADS
+    if (console->sinkThread)
+    {
+        if (SDL_SemValue(console->sinkWork) == 0)
+            SDL_SemPost(console->sinkWork);
+        return;
+    }
+#endif
+
+    OGLCONSOLE_FlushSinks(console);
+}
+
+/* Add a sink to a console, starting its writer thread if it doesn't have one
+ * yet */
+static int OGLCONSOLE_AddSink(_OGLCONSOLE_Console *console, int fd,
+        void (*callback)(OGLCONSOLE_Console console, const char *text,
+                         int length, void *data),
+        void *data)
+{
+    OGLCONSOLE_Sink *sink;
+
+    if (console->sinkCount >= MAX_SINKS) return 0;
+
+    if (!console->sinkBuffer
+     && !(console->sinkBuffer = malloc(SINK_BUFFER_SIZE)))
+        return 0;
+
+    sink = console->sinks + console->sinkCount;
+    sink->fd = fd;
+    sink->callback = callback;
+    sink->data = data;
+
+    /* The writer thread may be looking at sinkCount right now */
+    OGLCONSOLE_BARRIER();
+    console->sinkCount++;
+
+#ifdef OGLCONSOLE_THREADS
+    if (!console->sinkThread)
+    {
+        console->sinkQuit = 0;
+        console->sinkWork = SDL_CreateSemaphore(0);
+        if (console->sinkWork)
+            console->sinkThread = SDL_CreateThread(OGLCONSOLE_SinkThread,
+                                                   console);
+    }
+#endif
+
+    return 1;
+}
+
+/* Write out everything left for a console's sinks, and close them */
+static void OGLCONSOLE_CloseSinks(_OGLCONSOLE_Console *console)
+{
+    int i;
+
+#ifdef OGLCONSOLE_THREADS
+    if (console->sinkThread)
+    {
+        console->sinkQuit = 1;
+        SDL_SemPost(console->sinkWork);
+        SDL_WaitThread(console->sinkThread, NULL);
+        console->sinkThread = NULL;
+    }
+    if (console->sinkWork)
+        SDL_DestroySemaphore(console->sinkWork);
+    console->sinkWork = NULL;
+#endif
+
+    OGLCONSOLE_FlushSinks(console);
+
+#ifdef OGLCONSOLE_POSIX
+    for (i = 0; i < console->sinkCount; i++)
+        if (!console->sinks[i].callback)
+            close(console->sinks[i].fd);
+#endif
+
+    console->sinkCount = 0;
+    free(console->sinkBuffer);
+    console->sinkBuffer = NULL;
+}
+
+/* Find the first newline, carriage return, tab, NUL, or start of a color
+ * code (escape or '^') in s, stopping at end. Output comes in long runs of
+ * plain text, so we look at 16 or 32 bytes at a time where the CPU lets us.
+ * Control characters are found with one unsigned comparison, and then told
+ * apart */
+#define OGLCONSOLE_SPECIAL(c) \
+    ((c) == '\n' || (c) == '\r' || (c) == '\t' || (c) == '\0' \
+  || (c) == '\x1b' || (c) == '^')
+
+static const char *OGLCONSOLE_FindSpecial(const char *s, const char *end)
+{
+#if defined(__AVX2__)
+    const __m256i controls32 = _mm256_set1_epi8(0x1b),
+                  caret32 = _mm256_set1_epi8('^');
+
+    for (; end - s >= 32; s += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)s);
+        unsigned int mask = _mm256_movemask_epi8(_mm256_or_si256(
+                _mm256_cmpeq_epi8(_mm256_min_epu8(v, controls32), v),
+                _mm256_cmpeq_epi8(v, caret32)));
+
+        for (; mask; mask &= mask - 1)
+            if (OGLCONSOLE_SPECIAL(s[__builtin_ctz(mask)]))
+                return s + __builtin_ctz(mask);
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i controls = _mm_set1_epi8(0x1b), caret = _mm_set1_epi8('^');
+
+    for (; end - s >= 16; s += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)s);
+        unsigned int mask = _mm_movemask_epi8(_mm_or_si128(
+                _mm_cmpeq_epi8(_mm_min_epu8(v, controls), v),
+                _mm_cmpeq_epi8(v, caret)));
+
+        for (; mask; mask &= mask - 1)
+            if (OGLCONSOLE_SPECIAL(s[__builtin_ctz(mask)]))
+                return s + __builtin_ctz(mask);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; end - s >= 16; s += 16)
+    {
+        uint8x16_t v = vld1q_u8((const uint8_t*)s);
+        uint8x16_t m = vorrq_u8(vcleq_u8(v, vdupq_n_u8(0x1b)),
+                                vceqq_u8(v, vdupq_n_u8('^')));
+
+        /* The scalar loop below finds which byte it was */
+        if (vmaxvq_u8(m)) break;
+    }
+#endif
+
+    while (s < end && !OGLCONSOLE_SPECIAL(*s))
+        s++;
+
+    return s;
+}
+
+/* The colors of the 16 ANSI colors, and of Quake's ^0 to ^9. Black is 0x010101
+ * since 0 means the usual color */
+static const unsigned int OGLCONSOLE_ansiColors[16] =
+{
+    0x010101, 0xcd0000, 0x00cd00, 0xcdcd00, 0x0000ee, 0xcd00cd, 0x00cdcd,
+    0xe5e5e5, 0x7f7f7f, 0xff0000, 0x00ff00, 0xffff00, 0x5c5cff, 0xff00ff,
+    0x00ffff, 0xffffff
+};
+
+static const unsigned int OGLCONSOLE_quakeColors[10] =
+{
+    0x010101, 0xff0000, 0x00ff00, 0xffff00, 0x0000ff, 0x00ffff, 0xff00ff,
+    0xffffff, 0xff8000, 0x808080
+};
+
+/* The color of entry n of the 256 color xterm palette */
+static unsigned int OGLCONSOLE_PaletteColor(int n)
+{
+    static const unsigned char level[6] = { 0, 95, 135, 175, 215, 255 };
+
+    if (n < 16)
+        return OGLCONSOLE_ansiColors[max(n, 0)];
+
+    if (n < 232)
+    {
+        n -= 16;
+        return level[n / 36] << 16 | level[n / 6 % 6] << 8 | level[n % 6]
+             | (n ? 0 : 0x010101);
+    }
+
+    n = 8 + (min(n, 255) - 232) * 10;
+    return n << 16 | n << 8 | n;
+}
+
+/* Set *color by the count parameters of a Select Graphic Rendition escape
+ * sequence. Only foreground colors are understood: 16 color, 256 color and 24
+ * bit ones. Background colors are skipped over, and the rest ignored */
+static void OGLCONSOLE_SGR(unsigned int *color, const int *p, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (p[i] == 0 || p[i] == 39)
+            *color = 0;
+        else if (p[i] >= 30 && p[i] <= 37)
+            *color = OGLCONSOLE_ansiColors[p[i] - 30];
+        else if (p[i] >= 90 && p[i] <= 97)
+            *color = OGLCONSOLE_ansiColors[p[i] - 90 + 8];
+
+        /* Extended colors; the background's are skipped over */
+        else if ((p[i] == 38 || p[i] == 48) && i + 1 < count)
+        {
+            if (p[i + 1] == 5 && i + 2 < count)
+            {
+                if (p[i] == 38)
+                    *color = OGLCONSOLE_PaletteColor(p[i + 2]);
+                i += 2;
+            }
+            else if (p[i + 1] == 2 && i + 4 < count)
+            {
+                if (p[i] == 38)
+                    *color = (p[i + 2] & 0xff) << 16
+                           | (p[i + 3] & 0xff) << 8
+                           | (p[i + 4] & 0xff)
+                           | 0x010101 * !(p[i + 2] | p[i + 3] | p[i + 4]);
+                i += 4;
+            }
+        }
+    }
+}
+
+/* Apply a complete ANSI escape sequence (escape, '[', parameters, and the
+ * final byte). Only Select Graphic Rendition (final byte 'm') does anything:
+ * it sets the foreground color. Everything else is thrown away */
+static void OGLCONSOLE_ApplyEscape(_OGLCONSOLE_Console *console,
+                                   const char *s, int n)
+{
+    int p[16], count = 0, i;
+
+    if (n < 3 || s[1] != '[' || s[n - 1] != 'm') return;
+
+    /* Parameters are numbers separated by semicolons; missing ones are 0 */
+    for (i = 2, p[0] = 0; i < n - 1 && count < 16; i++)
+    {
+        if (s[i] >= '0' && s[i] <= '9')
+            p[count] = p[count] * 10 + s[i] - '0';
+        else if (s[i] == ';' && ++count < 16)
+            p[count] = 0;
+    }
+
+    OGLCONSOLE_SGR(&console->ansiColor, p, min(count + 1, 16));
+}
+
+/* Take a color code out of output, returning where the output goes on after
+ * it, or s itself if s isn't the start of one. An escape sequence which is cut
+ * off at end is kept in the console until the rest of it comes. Escape
+ * sequences are CSI (escape, '[', and up to a byte from '@' to '~'), OSC
+ * (escape, ']', and up to a BEL or escape '\'), or escape and one other byte.
+ * Quake codes are '^' and a digit; a '^' at end is kept too, and if what comes
+ * next isn't a digit, the caller outputs it after all */
+static const char *OGLCONSOLE_ColorCode(_OGLCONSOLE_Console *console,
+                                        const char *s, const char *end)
+{
+    char *e = console->escape;
+
+    if (console->escapeLength && e[0] == '^')
+    {
+        console->escapeLength = 0;
+        console->quakeColor = OGLCONSOLE_quakeColors[*s - '0'];
+        return s + 1;
+    }
+
+    if (!console->escapeLength)
+    {
+        if (*s == '^')
+        {
+            if (!(console->colorCodes & OGLCONSOLE_COLORS_QUAKE))
+                return s;
+
+            if (s + 1 == end)
+            {
+                e[0] = '^';
+                console->escapeLength = 1;
+                return end;
+            }
+
+            if (s[1] < '0' || s[1] > '9')
+                return s;
+
+            console->quakeColor = OGLCONSOLE_quakeColors[s[1] - '0'];
+            return s + 2;
+        }
+
+        if (*s != '\x1b' || !(console->colorCodes & OGLCONSOLE_COLORS_ANSI))
+            return s;
+    }
+
+    while (s < end)
+    {
+        char c = *s++;
+        int n = ++console->escapeLength;
+
+        /* Overlong sequences are given up on, but still swallowed */
+        if (n <= MAX_ESCAPE_LENGTH)
+            e[n - 1] = c;
+
+        if ((n == 2 && c != '[' && c != ']')
+         || (n > 2 && e[1] == ']' && (c == '\a'
+             || (c == '\\' && e[min(n, MAX_ESCAPE_LENGTH) - 2] == '\x1b'))))
+        {
+            console->escapeLength = 0;
+            return s;
+        }
+
+        if (n > 2 && e[1] == '[' && c >= '@' && c <= '~')
+        {
+            if (n <= MAX_ESCAPE_LENGTH)
+                OGLCONSOLE_ApplyEscape(console, e, n);
+            console->escapeLength = 0;
+            return s;
+        }
+    }
+
+    return end;
+}
+
+/* The terminal's escape sequence parser is a state machine, after the VT500
+ * series' own: each byte, in each state, does one of a few things and moves
+ * to another state. The table says which, in the high four bits and the low
+ * four of a byte */
+enum
+{
+    VT_GROUND,
+    VT_ESCAPE,
+    VT_ESCAPE_INTERMEDIATE,
+    VT_CSI_ENTRY,
+    VT_CSI_PARAM,
+    VT_CSI_INTERMEDIATE,
+    VT_CSI_IGNORE,
+    VT_STRING,
+    VT_STATES
+};
+
+enum
+{
+    VT_IGNORE,
+    VT_PRINT,
+    VT_EXECUTE,
+    VT_CLEAR,
+    VT_COLLECT,
+    VT_PARAM,
+    VT_ESCAPE_DISPATCH,
+    VT_CSI_DISPATCH
+};
+
+static unsigned char OGLCONSOLE_vtTable[VT_STATES][256];
+
+static void OGLCONSOLE_VTRange(int state, int from, int to, int action,
+                               int next)
+{
+    while (from <= to)
+        OGLCONSOLE_vtTable[state][from++] = action << 4 | next;
+}
+
+/* Fill in the parser's table, the first time a terminal is made */
+static void OGLCONSOLE_InitVT()
+{
+    int s;
+
+    if (OGLCONSOLE_vtTable[VT_GROUND][' ']) return;
+
+    for (s = 0; s < VT_STATES; s++)
+    {
+        /* Mostly, bytes are ignored and control characters are carried out
+         * in the middle of sequences, except in strings */
+        OGLCONSOLE_VTRange(s, 0x00, 0xff, VT_IGNORE, s);
+        if (s != VT_STRING)
+            OGLCONSOLE_VTRange(s, 0x00, 0x1f, VT_EXECUTE, s);
+
+        /* Anywhere, these cancel a sequence or start a new one */
+        OGLCONSOLE_VTRange(s, 0x18, 0x18, VT_EXECUTE, VT_GROUND);
+        OGLCONSOLE_VTRange(s, 0x1a, 0x1a, VT_EXECUTE, VT_GROUND);
+        OGLCONSOLE_VTRange(s, 0x1b, 0x1b, VT_CLEAR, VT_ESCAPE);
+    }
+
+    /* Text; bytes past ASCII are characters of the font too */
+    OGLCONSOLE_VTRange(VT_GROUND, 0x20, 0x7e, VT_PRINT, VT_GROUND);
+    OGLCONSOLE_VTRange(VT_GROUND, 0x80, 0xff, VT_PRINT, VT_GROUND);
+
+    OGLCONSOLE_VTRange(VT_ESCAPE, 0x20, 0x2f, VT_COLLECT,
+                       VT_ESCAPE_INTERMEDIATE);
+    OGLCONSOLE_VTRange(VT_ESCAPE, 0x30, 0x7e, VT_ESCAPE_DISPATCH, VT_GROUND);
+    OGLCONSOLE_VTRange(VT_ESCAPE, '[', '[', VT_IGNORE, VT_CSI_ENTRY);
+    OGLCONSOLE_VTRange(VT_ESCAPE, ']', ']', VT_IGNORE, VT_STRING);
+    OGLCONSOLE_VTRange(VT_ESCAPE, 'P', 'P', VT_IGNORE, VT_STRING);
+    OGLCONSOLE_VTRange(VT_ESCAPE, 'X', 'X', VT_IGNORE, VT_STRING);
+    OGLCONSOLE_VTRange(VT_ESCAPE, '^', '_', VT_IGNORE, VT_STRING);
+
+    OGLCONSOLE_VTRange(VT_ESCAPE_INTERMEDIATE, 0x20, 0x2f, VT_COLLECT,
+                       VT_ESCAPE_INTERMEDIATE);
+    OGLCONSOLE_VTRange(VT_ESCAPE_INTERMEDIATE, 0x30, 0x7e, VT_ESCAPE_DISPATCH,
+                       VT_GROUND);
+
+    /* Parameters are digits, separated by ';' or ':'; '<' to '?' first are a
+     * private marker, and anywhere else spoil the sequence */
+    OGLCONSOLE_VTRange(VT_CSI_ENTRY, 0x20, 0x2f, VT_COLLECT,
+                       VT_CSI_INTERMEDIATE);
+    OGLCONSOLE_VTRange(VT_CSI_ENTRY, 0x30, 0x3b, VT_PARAM, VT_CSI_PARAM);
+    OGLCONSOLE_VTRange(VT_CSI_ENTRY, 0x3c, 0x3f, VT_COLLECT, VT_CSI_PARAM);
+    OGLCONSOLE_VTRange(VT_CSI_ENTRY, 0x40, 0x7e, VT_CSI_DISPATCH, VT_GROUND);
+
+    OGLCONSOLE_VTRange(VT_CSI_PARAM, 0x20, 0x2f, VT_COLLECT,
+                       VT_CSI_INTERMEDIATE);
+    OGLCONSOLE_VTRange(VT_CSI_PARAM, 0x30, 0x3b, VT_PARAM, VT_CSI_PARAM);
+    OGLCONSOLE_VTRange(VT_CSI_PARAM, 0x3c, 0x3f, VT_IGNORE, VT_CSI_IGNORE);
+    OGLCONSOLE_VTRange(VT_CSI_PARAM, 0x40, 0x7e, VT_CSI_DISPATCH, VT_GROUND);
+
+    OGLCONSOLE_VTRange(VT_CSI_INTERMEDIATE, 0x20, 0x2f, VT_COLLECT,
+                       VT_CSI_INTERMEDIATE);
+    OGLCONSOLE_VTRange(VT_CSI_INTERMEDIATE, 0x30, 0x3f, VT_IGNORE,
+                       VT_CSI_IGNORE);
+    OGLCONSOLE_VTRange(VT_CSI_INTERMEDIATE, 0x40, 0x7e, VT_CSI_DISPATCH,
+                       VT_GROUND);
+
+    OGLCONSOLE_VTRange(VT_CSI_IGNORE, 0x40, 0x7e, VT_IGNORE, VT_GROUND);
+
+    /* OSC and other strings end with BEL, or escape '\' (which is an escape
+     * sequence doing nothing) */
+    OGLCONSOLE_VTRange(VT_STRING, 0x07, 0x07, VT_IGNORE, VT_GROUND);
+}
+
+/* Blank cells from up to to, counting across rows */
+static void OGLCONSOLE_VTErase(OGLCONSOLE_Terminal *t, int from, int to)
+{
+    if (to <= from) return;
+
+    memset(t->dirty + from / t->columns, 1,
+           (to - 1) / t->columns - from / t->columns + 1);
+    memset(t->cells + from, ' ', to - from);
+    memset(t->colors + from, 0, (to - from) * sizeof(unsigned int));
+}
+
+/* Put a row of the screen into the scrollback as a line of its own, with its
+ * colors */
+static void OGLCONSOLE_VTScrollOff(_OGLCONSOLE_Console *console, int row)
+{
+    OGLCONSOLE_Terminal *t = console->terminal;
+    const char *cells = t->cells + row * t->columns;
+    const unsigned int *colors = t->colors + row * t->columns;
+    int n = t->columns, i, j;
+
+    /* Blanks on the end aren't kept */
+    while (n > 0 && cells[n - 1] == ' ')
+        n--;
+
+    if (console->outputNewline
+     || OGLCONSOLE_LineLength(console, console->lineQueueIndex))
+    {
+        if (!console->outputNewline)
+            OGLCONSOLE_EndLine(console);
+        OGLCONSOLE_NewLine(console);
+    }
+
+    for (i = 0; i < n; i = j)
+    {
+        for (j = i + 1; j < n && colors[j] == colors[i]; j++);
+        OGLCONSOLE_AppendColored(console, cells + i, j - i, colors[i]);
+    }
+
+    OGLCONSOLE_EndLine(console);
+    console->outputNewline = 1;
+}
+
+/* Scroll rows top up to bottom of the screen up by n rows, or down if n is
+ * negative, blanking the rows uncovered. With keep, rows scrolled off the top
+ * of the screen go into the scrollback */
+static void OGLCONSOLE_VTScroll(_OGLCONSOLE_Console *console, int top,
+                                int bottom, int n, int keep)
+{
+    OGLCONSOLE_Terminal *t = console->terminal;
+    int w = t->columns, i, k = min(abs(n), bottom - top);
+
+    if (k <= 0) return;
+
+    memset(t->dirty + top, 1, bottom - top);
+
+    if (n > 0)
+    {
+        if (keep && top == 0 && !t->alternate)
+            for (i = 0; i < k; i++)
+                OGLCONSOLE_VTScrollOff(console, i);
+
+        memmove(t->cells + top * w, t->cells + (top + k) * w,
+                (bottom - top - k) * w);
+        memmove(t->colors + top * w, t->colors + (top + k) * w,
+                (bottom - top - k) * w * sizeof(unsigned int));
+        OGLCONSOLE_VTErase(t, (bottom - k) * w, bottom * w);
+    }
+    else
+    {
+        memmove(t->cells + (top + k) * w, t->cells + top * w,
+                (bottom - top - k) * w);
+        memmove(t->colors + (top + k) * w, t->colors + top * w,
+                (bottom - top - k) * w * sizeof(unsigned int));
+        OGLCONSOLE_VTErase(t, top * w, (top + k) * w);
+    }
+}
+
+/* Move the cursor, keeping it on the screen */
+static void OGLCONSOLE_VTMove(OGLCONSOLE_Terminal *t, int x, int y)
+{
+    t->x = max(0, min(x, t->columns - 1));
+    t->y = max(0, min(y, t->rows - 1));
+    t->wrapPending = 0;
+}
+
+/* Move the cursor down a row, scrolling at the bottom of the scrolling
+ * region, or up a row, scrolling at the top */
+static void OGLCONSOLE_VTIndex(_OGLCONSOLE_Console *console)
+{
+    OGLCONSOLE_Terminal *t = console->terminal;
+
+    if (t->y == t->bottom - 1)
+        OGLCONSOLE_VTScroll(console, t->top, t->bottom, 1, 1);
+    else
+        OGLCONSOLE_VTMove(t, t->x, t->y + 1);
+
+    t->wrapPending = 0;
+}
+
+static void OGLCONSOLE_VTReverseIndex(_OGLCONSOLE_Console *console)
+{
+    OGLCONSOLE_Terminal *t = console->terminal;
+
+    if (t->y == t->top)
+        OGLCONSOLE_VTScroll(console, t->top, t->bottom, -1, 0);
+    else
+        OGLCONSOLE_VTMove(t, t->x, t->y - 1);
+
+    t->wrapPending = 0;
+}
+
+/* Put the terminal back how it started, with a blank screen */
+static void OGLCONSOLE_VTReset(OGLCONSOLE_Terminal *t)
+{
+    /* The screen we're on is the one that stays */
+    free(t->mainCells);
+    free(t->mainColors);
+    t->mainCells = NULL;
+    t->mainColors = NULL;
+
+    OGLCONSOLE_VTErase(t, 0, t->columns * t->rows);
+    t->x = t->y = t->wrapPending = t->savedX = t->savedY = 0;
+    t->color = t->savedColor = 0;
+    t->top = 0;
+    t->bottom = t->rows;
+    t->cursorShown = t->autowrap = 1;
+    t->newlineMode = t->alternate = 0;
+}
+
+/* Put n characters onto the screen at the cursor, wrapping at the right edge
+ * if autowrap is on, and otherwise writing over the last column */
+static void OGLCONSOLE_VTPrint(_OGLCONSOLE_Console *console, const char *s,
+                               int n)
+{
+    OGLCONSOLE_Terminal *t = console->terminal;
+
+    while (n > 0)
+    {
+        int k, at, i;
+
+        if (t->wrapPending)
+        {
+            OGLCONSOLE_VTIndex(console);
+            t->x = 0;
+        }
+
+        k = min(n, t->columns - t->x);
+        at = t->y * t->columns + t->x;
+        t->dirty[t->y] = 1;
+        memcpy(t->cells + at, s, k);
+        for (i = 0; i < k; i++)
+            t->colors[at + i] = t->color;
+
+        s += k;
+        n -= k;
+
+        if (t->x + k < t->columns)
+        {
+            t->x += k;
+            continue;
+        }
+
+        /* At the right edge, the cursor stays on the last column */
+        t->x = t->columns - 1;
+
+        if (t->autowrap)
+            t->wrapPending = 1;
+        else if (n)
+        {
+            /* Without wrapping, only the last character stays, in the
+             * color it was written in */
+            t->cells[at + k - 1] = s[n - 1];
+            t->colors[at + k - 1] = t->color;
+            n = 0;
+        }
+    }
+}
+
+/* Carry out a control character */
+static void OGLCONSOLE_VTExecute(_OGLCONSOLE_Console *console, int c)
+{
+    OGLCONSOLE_Terminal *t = console->terminal;
+
+    switch (c)
+    {
+        case '\b':
+            OGLCONSOLE_VTMove(t, t->x - 1, t->y);
+            break;
+
+        case '\t':
+            OGLCONSOLE_VTMove(t, t->x + TAB_WIDTH - t->x % TAB_WIDTH, t->y);
+            break;
+
+        case '\n':
+        case '\v':
+        case '\f':
+            OGLCONSOLE_VTIndex(console);
+            if (t->newlineMode)
+                t->x = 0;
+            break;
+
+        case '\r':
+            OGLCONSOLE_VTMove(t, 0, t->y);
+            break;
+    }
+}
+
+/* Save the cursor and color, or go back to the ones saved */
+static void OGLCONSOLE_VTSaveCursor(OGLCONSOLE_Terminal *t, int save)
+{
+    if (save)
+    {
+        t->savedX = t->x;
+        t->savedY = t->y;
+        t->savedColor = t->color;
+    }
+    else
+    {
+        OGLCONSOLE_VTMove(t, t->savedX, t->savedY);
+        t->color = t->savedColor;
+    }
+}
+
+/* Carry out an escape sequence which isn't a control sequence; c is its last
+ * byte. Those with intermediates (character sets and such) are ignored */
+static void OGLCONSOLE_VTEscape(_OGLCONSOLE_Console *console, int c)
+{
+    OGLCONSOLE_Terminal *t = console->terminal;
+
+    if (t->intermediateCount) return;
+
+    switch (c)
+    {
+        case '7':
+        case '8':
+            OGLCONSOLE_VTSaveCursor(t, c == '7');
+            break;
+
+        case 'D':
+            OGLCONSOLE_VTIndex(console);
+            break;
+
+        case 'E':
+            OGLCONSOLE_VTIndex(console);
+            t->x = 0;
+            break;
+
+        case 'M':
+            OGLCONSOLE_VTReverseIndex(console);
+            break;
+
+        case 'c':
+            OGLCONSOLE_VTReset(t);
+            break;
+    }
+}
+
+/* Switch to the alternate screen, keeping the usual one to bring back when
+ * switching back again. If the screen has changed size meanwhile, what fits
+ * of it comes back; if there was no memory to keep it, it comes back blank */
+static void OGLCONSOLE_VTAlternate(OGLCONSOLE_Terminal *t, int on)
+{
+    int n = t->columns * t->rows, row, columns;
+    char *cells;
+    unsigned int *colors;
+
+    t->alternate = on;
+    memset(t->dirty, 1, t->rows);
+
+    if (on)
+    {
+        cells = malloc(n);
+        colors = malloc(n * sizeof(unsigned int));
+        if (cells && colors)
+        {
+            t->mainCells = t->cells;
+            t->mainColors = t->colors;
+            t->mainColumns = t->columns;
+            t->mainRows = t->rows;
+            t->cells = cells;
+            t->colors = colors;
+        }
+        else
+        {
+            free(cells);
+            free(colors);
+        }
+
+        OGLCONSOLE_VTErase(t, 0, n);
+        return;
+    }
+
+    if (!t->mainCells)
+    {
+        OGLCONSOLE_VTErase(t, 0, n);
+        return;
+    }
+
+    if (t->mainColumns == t->columns && t->mainRows == t->rows)
+    {
+        free(t->cells);
+        free(t->colors);
+        t->cells = t->mainCells;
+        t->colors = t->mainColors;
+    }
+    else
+    {
+        OGLCONSOLE_VTErase(t, 0, n);
+        columns = min(t->columns, t->mainColumns);
+
+        for (row = 0; row < min(t->rows, t->mainRows); row++)
+        {
+            memcpy(t->cells + row * t->columns,
+                   t->mainCells + row * t->mainColumns, columns);
+            memcpy(t->colors + row * t->columns,
+                   t->mainColors + row * t->mainColumns,
+                   columns * sizeof(unsigned int));
+        }
+
+        free(t->mainCells);
+        free(t->mainColors);
+    }
+
+    t->mainCells = NULL;
+    t->mainColors = NULL;
+}
+
+/* Set or reset the modes in a control sequence's parameters */
+static void OGLCONSOLE_VTModes(_OGLCONSOLE_Console *console, int set)
+{
+    OGLCONSOLE_Terminal *t = console->terminal;
+    int i, private = t->intermediateCount && t->intermediates[0] == '?';
+
+    for (i = 0; i < t->paramCount; i++)
+    {
+        int mode = t->params[i];
+
+        if (!private)
+        {
+            if (mode == 20)
+                t->newlineMode = set;
+        }
+        else if (mode == 7)
+            t->autowrap = set;
+        else if (mode == 25)
+            t->cursorShown = set;
+
+        /* The alternate screen is a blank one, for full screen programs,
+         * which doesn't put anything into the scrollback */
+        else if ((mode == 47 || mode == 1047 || mode == 1049)
+              && set != t->alternate)
+        {
+            if (mode == 1049 && set)
+                OGLCONSOLE_VTSaveCursor(t, 1);
+
+            OGLCONSOLE_VTAlternate(t, set);
+
+            if (mode == 1049 && !set)
+                OGLCONSOLE_VTSaveCursor(t, 0);
+        }
+    }
+}
+
+/* Carry out a control sequence (CSI); c is its last byte */
+static void OGLCONSOLE_VTControl(_OGLCONSOLE_Console *console, int c)
+{
+    OGLCONSOLE_Terminal *t = console->terminal;
+    int *p = t->params, w = t->columns, at = t->y * w + t->x;
+
+    /* Most parameters are counts, where 0 or none means 1 */
+    int a = t->paramCount && p[0] ? p[0] : 1,
+        b = t->paramCount > 1 && p[1] ? p[1] : 1;
+
+    /* Private sequences are only for modes; the rest, with intermediates,
+     * aren't understood */
+    if (t->intermediateCount
+     && (t->intermediates[0] != '?' || (c != 'h' && c != 'l')))
+        return;
+
+    switch (c)
+    {
+        case 'A':
+            OGLCONSOLE_VTMove(t, t->x, max(t->y - a, t->y >= t->top
+                                                     ? t->top : 0));
+            break;
+
+        case 'B':
+        case 'e':
+            OGLCONSOLE_VTMove(t, t->x, min(t->y + a, t->y < t->bottom
+                                                     ? t->bottom - 1
+                                                     : t->rows - 1));
+            break;
+
+        case 'C':
+        case 'a':
+            OGLCONSOLE_VTMove(t, t->x + a, t->y);
+            break;
+
+        case 'D':
+            OGLCONSOLE_VTMove(t, t->x - a, t->y);
+            break;
+
+        case 'E':
+            OGLCONSOLE_VTMove(t, 0, t->y + a);
+            break;
+
+        case 'F':
+            OGLCONSOLE_VTMove(t, 0, t->y - a);
+            break;
+
+        case 'G':
+        case '`':
+            OGLCONSOLE_VTMove(t, a - 1, t->y);
+            break;
+
+        case 'd':
+            OGLCONSOLE_VTMove(t, t->x, a - 1);
+            break;
+
+        case 'H':
+        case 'f':
+            OGLCONSOLE_VTMove(t, b - 1, a - 1);
+            break;
+
+        /* Erase below the cursor, above it, or all of the screen */
+        case 'J':
+            a = t->paramCount ? p[0] : 0;
+            if (a == 0)
+                OGLCONSOLE_VTErase(t, at, w * t->rows);
+            else if (a == 1)
+                OGLCONSOLE_VTErase(t, 0, at + 1);
+            else
+                OGLCONSOLE_VTErase(t, 0, w * t->rows);
+            break;
+
+        /* And the same for the cursor's row */
+        case 'K':
+            a = t->paramCount ? p[0] : 0;
+            if (a == 0)
+                OGLCONSOLE_VTErase(t, at, (t->y + 1) * w);
+            else if (a == 1)
+                OGLCONSOLE_VTErase(t, t->y * w, at + 1);
+            else
+                OGLCONSOLE_VTErase(t, t->y * w, (t->y + 1) * w);
+            break;
+
+        /* Insert and delete rows at the cursor, in the scrolling region */
+        case 'L':
+        case 'M':
+            if (t->y >= t->top && t->y < t->bottom)
+            {
+                OGLCONSOLE_VTScroll(console, t->y, t->bottom,
+                                    c == 'L' ? -a : a, 0);
+                OGLCONSOLE_VTMove(t, 0, t->y);
+            }
+            break;
+
+        /* Insert, delete and erase characters at the cursor */
+        case '@':
+        case 'P':
+        {
+            int k = min(a, w - t->x), end = (t->y + 1) * w;
+
+            if (c == '@')
+            {
+                memmove(t->cells + at + k, t->cells + at, end - at - k);
+                memmove(t->colors + at + k, t->colors + at,
+                        (end - at - k) * sizeof(unsigned int));
+                OGLCONSOLE_VTErase(t, at, at + k);
+            }
+            else
+            {
+                memmove(t->cells + at, t->cells + at + k, end - at - k);
+                memmove(t->colors + at, t->colors + at + k,
+                        (end - at - k) * sizeof(unsigned int));
+                OGLCONSOLE_VTErase(t, end - k, end);
+            }
+            t->wrapPending = 0;
+            break;
+        }
+
+        case 'X':
+            OGLCONSOLE_VTErase(t, at, at + min(a, w - t->x));
+            break;
+
+        case 'S':
+            OGLCONSOLE_VTScroll(console, t->top, t->bottom, a, 1);
+            break;
+
+        case 'T':
+            OGLCONSOLE_VTScroll(console, t->top, t->bottom, -a, 0);
+            break;
+
+        /* Set the scrolling region, of two rows at least */
+        case 'r':
+            a = t->paramCount && p[0] ? p[0] - 1 : 0;
+            b = t->paramCount > 1 && p[1] ? min(p[1], t->rows) : t->rows;
+            if (b - a >= 2)
+            {
+                t->top = a;
+                t->bottom = b;
+                OGLCONSOLE_VTMove(t, 0, 0);
+            }
+            break;
+
+        case 'm':
+            OGLCONSOLE_SGR(&t->color, p, max(t->paramCount, 1));
+            break;
+
+        case 's':
+            OGLCONSOLE_VTEscape(console, '7');
+            break;
+
+        case 'u':
+            OGLCONSOLE_VTEscape(console, '8');
+            break;
+
+        case 'h':
+        case 'l':
+            OGLCONSOLE_VTModes(console, c == 'h');
+            break;
+    }
+}
+
+/* Make the screen the size of the display's scrollback. The rows up to the
+ * cursor are kept, and any which no longer fit go into the scrollback.
+ * Returns 0 if there's no screen */
+static int OGLCONSOLE_VTResize(_OGLCONSOLE_Console *console)
+{
+    OGLCONSOLE_Terminal *t = console->terminal;
+    int columns = max(1, console->textWidth),
+        rows = max(1, console->textHeight - console->pinnedCount),
+        shift = max(0, t->y - rows + 1), row;
+    char *cells;
+    unsigned int *colors;
+    unsigned char *dirty;
+
+    if (columns == t->columns && rows == t->rows) return 1;
+
+    cells = malloc(columns * rows);
+    colors = malloc(columns * rows * sizeof(unsigned int));
+    dirty = malloc(rows);
+    if (!cells || !colors || !dirty)
+    {
+        free(cells);
+        free(colors);
+        free(dirty);
+        return t->cells != NULL;
+    }
+
+    memset(cells, ' ', columns * rows);
+    memset(colors, 0, columns * rows * sizeof(unsigned int));
+
+    if (!t->alternate)
+        for (row = 0; row < shift; row++)
+            OGLCONSOLE_VTScrollOff(console, row);
+
+    for (row = shift; row < t->rows && row - shift < rows; row++)
+    {
+        memcpy(cells + (row - shift) * columns, t->cells + row * t->columns,
+               min(columns, t->columns));
+        memcpy(colors + (row - shift) * columns, t->colors + row * t->columns,
+               min(columns, t->columns) * sizeof(unsigned int));
+    }
+
+    free(t->cells);
+    free(t->colors);
+    free(t->dirty);
+    t->cells = cells;
+    t->colors = colors;
+    t->dirty = dirty;
+    memset(dirty, 1, rows);
+    t->columns = columns;
+    t->rows = rows;
+    t->top = 0;
+    t->bottom = rows;
+
+    OGLCONSOLE_VTMove(t, t->x, t->y - shift);
+    t->savedX = min(t->savedX, columns - 1);
+    t->savedY = min(t->savedY, rows - 1);
+
+#if defined(OGLCONSOLE_POSIX) && defined(OGLCONSOLE_THREADS)
+    /* Tell a program running on the screen how big it is now */
+    if (console->child)
+    {
+        struct winsize size;
+
+        memset(&size, 0, sizeof(size));
+        size.ws_col = columns;
+        size.ws_row = rows;
+        ioctl(console->child->fd, TIOCSWINSZ, &size);
+    }
+#endif
+    return 1;
+}
+
+static void OGLCONSOLE_FreeFront(OGLCONSOLE_Terminal *t)
+{
+    if (t->lists)
+        glDeleteLists(t->lists, t->listRows);
+
+    free(t->frontCells);
+    free(t->frontColors);
+    free(t->frontHashes);
+    free(t->backHashes);
+    free(t->rowLists);
+    t->frontCells = NULL;
+    t->frontColors = NULL;
+    t->frontHashes = t->backHashes = NULL;
+    t->rowLists = NULL;
+    t->lists = 0;
+    t->listColumns = t->listRows = 0;
+}
+
+static void OGLCONSOLE_FreeTerminal(OGLCONSOLE_Terminal *t)
+{
+    if (!t) return;
+
+    OGLCONSOLE_FreeFront(t);
+    free(t->cells);
+    free(t->colors);
+    free(t->mainCells);
+    free(t->mainColors);
+    free(t->dirty);
+    free(t);
+}
+
+/* Put output onto a terminal's screen. The table drives the parser a byte at
+ * a time, except for text, which goes on a run at a time */
+static void OGLCONSOLE_TerminalWrite(_OGLCONSOLE_Console *console,
+                                     const char *s, int n)
+{
+    OGLCONSOLE_Terminal *t = console->terminal;
+    const char *end = s + n, *run;
+
+    if (!OGLCONSOLE_VTResize(console)) return;
+
+    while (s < end)
+    {
+        unsigned char c = *s++, next = OGLCONSOLE_vtTable[t->state][c];
+
+        t->state = next & 15;
+
+        switch (next >> 4)
+        {
+            case VT_PRINT:
+                for (run = s - 1; s < end
+                     && OGLCONSOLE_vtTable[VT_GROUND][(unsigned char)*s]
+                        == (VT_PRINT << 4 | VT_GROUND); s++);
+                OGLCONSOLE_VTPrint(console, run, s - run);
+                break;
+
+            case VT_EXECUTE:
+                OGLCONSOLE_VTExecute(console, c);
+                break;
+
+            case VT_CLEAR:
+                t->params[0] = t->paramCount = t->intermediateCount = 0;
+                break;
+
+            case VT_COLLECT:
+                if (t->intermediateCount < sizeof(t->intermediates))
+                    t->intermediates[t->intermediateCount++] = c;
+                break;
+
+            case VT_PARAM:
+                if (!t->paramCount)
+                    t->paramCount = 1;
+
+                if (c >= '0' && c <= '9')
+                    t->params[t->paramCount - 1] = min(9999,
+                            t->params[t->paramCount - 1] * 10 + c - '0');
+                else if (t->paramCount < MAX_TERMINAL_PARAMS)
+                    t->params[t->paramCount++] = 0;
+                break;
+
+            case VT_ESCAPE_DISPATCH:
+                OGLCONSOLE_VTEscape(console, c);
+                break;
+
+            case VT_CSI_DISPATCH:
+                OGLCONSOLE_VTControl(console, c);
+                break;
+        }
+    }
+}
+
+/* Put some text into a console's scrollback, handling newlines and tabs. Any
+ * NULs in it are skipped */
+static void OGLCONSOLE_Ingest(_OGLCONSOLE_Console *console, const char *text,
+                              int n)
+{
+    /* Is the display following new output? */
+    int follow;
+
+    /* string copy cursors */
+    const char *outputCursor = text, *end = text + n, *run;
+
+    OGLCONSOLE_CollectView(C);
+    follow = C->lineScrollIndex == OGLCONSOLE_LastShown(C)
+          && C->rowScrollIndex == 0 && C->scrollFraction == 0;
+
+    OGLCONSOLE_LockStorage();
+
+    /* Pick up blocks of scrollback which have been compressed meanwhile */
+    OGLCONSOLE_CollectPacked();
+
+    /* A terminal's screen takes all of it */
+    if (C->terminal)
+    {
+        OGLCONSOLE_TerminalWrite(C, text, n);
+        outputCursor = end;
+    }
+
+    while (outputCursor < end)
+    {
+        /* A '^' kept from the end of the last output which isn't followed by
+         * a digit was just text */
+        if (C->escapeLength && C->escape[0] == '^'
+         && (*outputCursor < '0' || *outputCursor > '9'))
+        {
+            C->escapeLength = 0;
+
+            if (C->outputNewline)
+            {
+                C->outputNewline = 0;
+                OGLCONSOLE_NewLine(C);
+            }
+
+            OGLCONSOLE_Append(C, "^", 1);
+        }
+
+        /* Color codes are taken out before anything else, so that one at the
+         * end of a line doesn't start the next */
+        if (C->escapeLength || *outputCursor == '\x1b' || *outputCursor == '^')
+        {
+            run = outputCursor;
+            outputCursor = OGLCONSOLE_ColorCode(C, outputCursor, end);
+            if (outputCursor != run) continue;
+        }
+
+        if (!*outputCursor)
+        {
+            outputCursor++;
+            continue;
+        }
+
+        /* Here we check to see if the last thing we output was a newline
+         * (indicated by "outputNewline"), which means we have to advance to
+         * the next line. We don't worry about the edge of the screen: lines
+         * are only wrapped when they are drawn */
+        if (C->outputNewline)
+        {
+            C->outputNewline = 0;
+            OGLCONSOLE_NewLine(C);
+        }
+
+        /* Copy everything up to the next special character in one go */
+        run = outputCursor;
+        outputCursor = OGLCONSOLE_FindSpecial(outputCursor, end);
+
+        if (outputCursor != run)
+        {
+            OGLCONSOLE_Append(C, run, outputCursor - run);
+            continue;
+        }
+
+        /* If we encounter a newline character, we set the newline flag, which
+         * tells the console to advance one line before it prints the next
+         * character. The reason we do it this way is to defer line-advancement,
+         * and thus we needn't suffer through a needless blank line between
+         * console output and the command line, wasting precious screen
+         * real-estate */
+        if (*outputCursor == '\n')
+        {
+            OGLCONSOLE_EndLine(C);
+            C->outputNewline = 1;
+            C->quakeColor = 0;
+            outputCursor++;
+            continue;
+        }
+
+        /* A carriage return goes back to the start of the line, so that
+         * what's output next writes over it, like a progress bar */
+        if (*outputCursor == '\r')
+        {
+            C->outputColumn = 0;
+            outputCursor++;
+            continue;
+        }
+
+        /* If we encounter a tab character we must expand that character
+         * appropriately. Like on a terminal, it only moves over text which
+         * is already on the line, and fills with spaces past its end */
+        if (*outputCursor == '\t')
+        {
+            int stop = C->outputColumn + TAB_WIDTH
+                     - C->outputColumn % TAB_WIDTH;
+
+            C->outputColumn = min(stop,
+                    OGLCONSOLE_LineLength(C, C->lineQueueIndex));
+            OGLCONSOLE_Append(C, "        ", stop - C->outputColumn);
+            outputCursor++;
+            continue;
+        }
+
+        /* An escape or '^' which doesn't start a color code is just text */
+        OGLCONSOLE_Append(C, outputCursor++, 1);
+    }
+
+    OGLCONSOLE_UnlockStorage();
+
+    /* Keep following new output */
+    if (follow)
+        C->lineScrollIndex = OGLCONSOLE_LastShown(C);
+}
+
+/* Add text to the output queued for a console. This may be called from any
+ * thread, and never waits for the console. Returns how much of the text was
+ * queued; the rest didn't fit */
+static int OGLCONSOLE_Enqueue(_OGLCONSOLE_Console *console, const char *text,
+                              int n)
+{
+#ifdef OGLCONSOLE_THREADS
+    if (!console->queueLock || n <= 0) return 0;
+
+    SDL_mutexP(console->queueLock);
+
+    n = min(n, MAX_QUEUED_OUTPUT - console->queuedLength);
+
+    if (console->queuedLength + n > console->queuedSize)
+    {
+        int size = max(console->queuedSize * 2, console->queuedLength + n);
+        char *queued = realloc(console->queued, max(size, 4096));
+
+        if (queued)
+        {
+            console->queued = queued;
+            console->queuedSize = max(size, 4096);
+        }
+        else
+            n = 0;
+    }
+
+    if (n > 0)
+    {
+        memcpy(console->queued + console->queuedLength, text, n);
+        console->queuedLength += n;
+    }
+
+    SDL_mutexV(console->queueLock);
+    return max(n, 0);
+#else
+    return 0;
+#endif
+}
+
+/* Microseconds since some time or other */
+static double OGLCONSOLE_Microseconds()
+{
+#if defined(OGLCONSOLE_POSIX) && defined(CLOCK_MONOTONIC)
+    struct timespec t;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &t) == 0)
+        return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+#endif
+    return SDL_GetTicks() * 1e3;
+}
+
+/* Put the first n bytes of a console's backlog into its scrollback, each
+ * stretch of it with the channel and severity it was output with */
+static void OGLCONSOLE_IngestBacklog(_OGLCONSOLE_Console *console, int n)
+{
+    const char *text = console->backlog + console->backlogStart;
+    OGLCONSOLE_BacklogTag *tag;
+    int k;
+
+    OGLCONSOLE_SinkOutput(console, text, n);
+
+    for (; n > 0; text += k, n -= k)
+    {
+        k = n;
+
+        if (console->tagStart < console->tagCount)
+        {
+            /* Move on to the tag we've got to */
+            while (console->tagStart + 1 < console->tagCount
+                && console->tags[console->tagStart + 1].offset
+                   <= console->backlogStart)
+                console->tagStart++;
+
+            tag = console->tags + console->tagStart;
+            console->outputChannel = tag->channel;
+            console->outputSeverity = tag->severity;
+
+            if (console->tagStart + 1 < console->tagCount)
+                k = min(k, tag[1].offset - console->backlogStart);
+        }
+
+        console->backlogStart += k;
+        OGLCONSOLE_Ingest(console, text, k);
+    }
+
+    console->outputChannel = -1;
+    console->outputSeverity = OGLCONSOLE_INFO;
+
+    if (console->backlogStart == console->backlogLength)
+    {
+        free(console->backlog);
+        console->backlog = NULL;
+        console->backlogStart = console->backlogLength = 0;
+        console->backlogSize = 0;
+        console->tagStart = console->tagCount = 0;
+    }
+}
+
+static int OGLCONSOLE_Reserve(void *p, int *size, int need, size_t bytes);
+
+/* Mark the end of a console's backlog with the tags of output about to go
+ * there, if they're not the ones it already ends with. Returns 0 if there's
+ * no memory for that */
+static int OGLCONSOLE_TagBacklog(_OGLCONSOLE_Console *console, int channel,
+                                 int severity)
+{
+    OGLCONSOLE_BacklogTag *tag;
+    int first = !console->tagCount;
+
+    if (first ? channel < 0
+              : console->tags[console->tagCount - 1].channel == channel
+             && console->tags[console->tagCount - 1].severity == severity)
+        return 1;
+
+    /* Make room by dropping the tags we're past */
+    if (console->tagCount + 2 > console->tagSize && console->tagStart)
+    {
+        memmove(console->tags, console->tags + console->tagStart,
+                (console->tagCount - console->tagStart)
+                * sizeof(OGLCONSOLE_BacklogTag));
+        console->tagCount -= console->tagStart;
+        console->tagStart = 0;
+    }
+
+    if (!OGLCONSOLE_Reserve(&console->tags, &console->tagSize,
+                            console->tagCount + 2,
+                            sizeof(OGLCONSOLE_BacklogTag)))
+        return 0;
+
+    /* What's already waiting was untagged */
+    if (first && console->backlogLength > console->backlogStart)
+    {
+        tag = console->tags + console->tagCount++;
+        tag->offset = console->backlogStart;
+        tag->channel = -1;
+        tag->severity = OGLCONSOLE_INFO;
+    }
+
+    tag = console->tags + console->tagCount++;
+    tag->offset = console->backlogLength;
+    tag->channel = channel;
+    tag->severity = severity;
+    return 1;
+}
+
+/* Put output in a console's scrollback right away, after its backlog */
+static void OGLCONSOLE_IngestNow(_OGLCONSOLE_Console *console,
+                                 const char *text, int n, int channel,
+                                 int severity)
+{
+    if (console->backlogLength > console->backlogStart)
+        OGLCONSOLE_IngestBacklog(console,
+                                 console->backlogLength - console->backlogStart);
+
+    OGLCONSOLE_SinkOutput(console, text, n);
+
+    console->outputChannel = channel;
+    console->outputSeverity = severity;
+    OGLCONSOLE_Ingest(console, text, n);
+    console->outputChannel = -1;
+    console->outputSeverity = OGLCONSOLE_INFO;
+}
+
+/* Add output, tagged with a channel and severity or with a channel of -1, to
+ * the end of a console's backlog. If the backlog gets too big, or there's no
+ * memory for it, output is put in the scrollback right away */
+static void OGLCONSOLE_Backlog(_OGLCONSOLE_Console *console, const char *text,
+                               int n, int channel, int severity)
+{
+    int length = console->backlogLength - console->backlogStart, i;
+
+    if (n <= 0) return;
+
+    if (console->backlogLength + n > console->backlogSize)
+    {
+        int size = max(console->backlogSize * 2, length + n);
+        char *backlog;
+
+        /* Move what's left to the front before making it any bigger */
+        if (console->backlogStart)
+        {
+            memmove(console->backlog, console->backlog + console->backlogStart,
+                    length);
+            for (i = console->tagStart; i < console->tagCount; i++)
+                console->tags[i].offset -= console->backlogStart;
+            console->backlogStart = 0;
+            console->backlogLength = length;
+        }
+
+        if (length + n > console->backlogSize)
+        {
+            if (!(backlog = realloc(console->backlog, max(size, 4096))))
+            {
+                OGLCONSOLE_IngestNow(console, text, n, channel, severity);
+                return;
+            }
+
+            console->backlog = backlog;
+            console->backlogSize = max(size, 4096);
+        }
+    }
+
+    if (!OGLCONSOLE_TagBacklog(console, channel, severity))
+    {
+        OGLCONSOLE_IngestNow(console, text, n, channel, severity);
+        return;
+    }
+
+    memcpy(console->backlog + console->backlogLength, text, n);
+    console->backlogLength += n;
+
+    if ((length += n) > MAX_BACKLOG)
+        OGLCONSOLE_IngestBacklog(console, length - MAX_BACKLOG);
+}
+
+/* Move whatever other threads have queued for a console to its backlog */
+static void OGLCONSOLE_TakeQueue(_OGLCONSOLE_Console *console)
+{
+#ifdef OGLCONSOLE_THREADS
+    char *queued;
+    int length, size;
+
+    if (!console->queueLock) return;
+
+    SDL_mutexP(console->queueLock);
+    queued = console->queued;
+    length = console->queuedLength;
+    size = console->queuedSize;
+    console->queued = NULL;
+    console->queuedLength = console->queuedSize = 0;
+    SDL_mutexV(console->queueLock);
+
+    if (!queued) return;
+
+    /* With nothing else waiting, the queue's buffer becomes the backlog */
+    if (!console->backlog)
+    {
+        console->backlog = queued;
+        console->backlogStart = 0;
+        console->backlogLength = length;
+        console->backlogSize = size;
+        return;
+    }
+
+    OGLCONSOLE_Backlog(console, queued, length, -1, OGLCONSOLE_INFO);
+    free(queued);
+#endif
+}
+
+/* Output whatever other threads have queued for a console, and its backlog */
+static void OGLCONSOLE_DrainQueue(_OGLCONSOLE_Console *console)
+{
+    OGLCONSOLE_TakeQueue(console);
+
+    if (console->backlogLength > console->backlogStart)
+        OGLCONSOLE_IngestBacklog(console,
+                                 console->backlogLength - console->backlogStart);
+}
+
+/* Output as much of a console's backlog, and whatever other threads have
+ * queued for it, as fits in its budget for a frame. Each batch is as much as
+ * the time left should be enough for, going by what batches have cost so far,
+ * and runs on to the end of a line so that lines aren't shown half done */
+static void OGLCONSOLE_DrainSome(_OGLCONSOLE_Console *console)
+{
+    double start, spent = 0, t;
+    const char *from, *end, *cut;
+    int n;
+
+    if (!console->drainBudget)
+    {
+        OGLCONSOLE_DrainQueue(console);
+        return;
+    }
+
+    OGLCONSOLE_TakeQueue(console);
+
+    start = OGLCONSOLE_Microseconds();
+
+    while (console->backlogLength > console->backlogStart
+        && spent < console->drainBudget)
+    {
+        from = console->backlog + console->backlogStart;
+        end = console->backlog + console->backlogLength;
+
+        n = min((console->drainBudget - spent) / console->drainCost,
+                end - from);
+        n = max(n, min(DRAIN_MIN_BATCH, end - from));
+
+        if ((cut = memchr(from + n - 1, '\n', end - from - n + 1)))
+            n = cut + 1 - from;
+        else
+            n = end - from;
+
+        t = OGLCONSOLE_Microseconds();
+        OGLCONSOLE_IngestBacklog(console, n);
+        spent = OGLCONSOLE_Microseconds() - start;
+
+        /* The clock may be too coarse to see small batches at all */
+        if ((t = start + spent - t) > 0)
+            console->drainCost = console->drainCost * 0.75 + t / n * 0.25;
+    }
+}
+
+#if defined(OGLCONSOLE_POSIX) && defined(OGLCONSOLE_THREADS)
+/* While stdout and stderr are captured, they're pipes which a reader thread
+ * empties CAPTURE_READ_SIZE bytes at a time into the capturing console's
+ * queue. The pipes are made CAPTURE_PIPE_SIZE big where we can, so writers
+ * seldom have to wait for the reader. The original file descriptors are kept
+ * in capturedFds, and wakeFds tells the reader to stop */
+#define CAPTURE_READ_SIZE (64 * 1024)
+#define CAPTURE_PIPE_SIZE (1024 * 1024)
+
+static _OGLCONSOLE_Console *OGLCONSOLE_captureConsole = NULL;
+static SDL_Thread *OGLCONSOLE_captureThread = NULL;
+static int OGLCONSOLE_captureFds[2] = { -1, -1 };
+static int OGLCONSOLE_capturedFds[2] = { -1, -1 };
+static int OGLCONSOLE_wakeFds[2] = { -1, -1 };
+static int OGLCONSOLE_passThrough = 0;
+
+/* Bytes of captured output which didn't fit in the console's queue. The
+ * reader can't wait for room instead, as that could leave it waiting for a
+ * console whose own thread is waiting to print */
+static unsigned long OGLCONSOLE_captureDropped = 0;
+
+/* Wake a thread polling the read end of a pipe. If nothing can be written,
+ * the write end is closed, which wakes it too */
+static void OGLCONSOLE_Wake(int *fds)
+{
+    ssize_t n;
+
+    while ((n = write(fds[1], "", 1)) < 0 && errno == EINTR);
+
+    if (n != 1)
+    {
+        close(fds[1]);
+        fds[1] = -1;
+    }
+}
+
+/* Read whatever is waiting in a capture pipe. Returns 0 at end of file */
+static int OGLCONSOLE_ReadCapture(int i, char *buffer)
+{
+    ssize_t n;
+
+    while ((n = read(OGLCONSOLE_captureFds[i], buffer, CAPTURE_READ_SIZE)) > 0)
+    {
+        n -= OGLCONSOLE_Enqueue(OGLCONSOLE_captureConsole, buffer, n);
+        if (n)
+            __sync_fetch_and_add(&OGLCONSOLE_captureDropped, n);
+
+        if (OGLCONSOLE_passThrough)
+        {
+            struct iovec iov;
+
+            iov.iov_base = buffer;
+            iov.iov_len = n;
+            OGLCONSOLE_WriteAll(OGLCONSOLE_capturedFds[i], &iov, 1);
+        }
+    }
+
+    return n < 0 && (errno == EAGAIN || errno == EINTR);
+}
+
+static int OGLCONSOLE_CaptureThread(void *unused)
+{
+    char *buffer = malloc(CAPTURE_READ_SIZE);
+    struct pollfd fds[3];
+    int i;
+
+    if (!buffer) return 0;
+
+    for (i = 0; i < 2; i++)
+        fds[i].fd = OGLCONSOLE_captureFds[i];
+    fds[2].fd = OGLCONSOLE_wakeFds[0];
+    for (i = 0; i < 3; i++)
+        fds[i].events = POLLIN;
+
+    while (fds[0].fd >= 0 || fds[1].fd >= 0)
+    {
+        if (poll(fds, 3, -1) < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (i = 0; i < 2; i++)
+            if (fds[i].revents && !OGLCONSOLE_ReadCapture(i, buffer))
+                fds[i].fd = -1;
+
+        /* Told to stop; stdout and stderr are already back where they were,
+         * so there's only what's left in the pipes to read */
+        if (fds[2].revents)
+        {
+            for (i = 0; i < 2; i++)
+                if (fds[i].fd >= 0)
+                    OGLCONSOLE_ReadCapture(i, buffer);
+            break;
+        }
+    }
+
+    free(buffer);
+    return 0;
+}
+
+/* Put stdout and stderr back, and close everything the capture used */
+static void OGLCONSOLE_Uncapture()
+{
+    int i;
+
+    fflush(stdout);
+    fflush(stderr);
+
+    for (i = 0; i < 2; i++)
+        if (OGLCONSOLE_capturedFds[i] >= 0)
+            dup2(OGLCONSOLE_capturedFds[i], i + 1);
+
+    if (OGLCONSOLE_captureThread)
+    {
+        OGLCONSOLE_Wake(OGLCONSOLE_wakeFds);
+        SDL_WaitThread(OGLCONSOLE_captureThread, NULL);
+        OGLCONSOLE_captureThread = NULL;
+    }
+
+    for (i = 0; i < 2; i++)
+    {
+        if (OGLCONSOLE_capturedFds[i] >= 0) close(OGLCONSOLE_capturedFds[i]);
+        if (OGLCONSOLE_captureFds[i] >= 0) close(OGLCONSOLE_captureFds[i]);
+        if (OGLCONSOLE_wakeFds[i] >= 0) close(OGLCONSOLE_wakeFds[i]);
+        OGLCONSOLE_capturedFds[i] = OGLCONSOLE_captureFds[i] = -1;
+        OGLCONSOLE_wakeFds[i] = -1;
+    }
+
+    OGLCONSOLE_captureConsole = NULL;
+}
+
+/* Send stdout and stderr through pipes to a console */
+static int OGLCONSOLE_Capture(_OGLCONSOLE_Console *console, int passThrough)
+{
+    int i, p[2];
+
+    OGLCONSOLE_Uncapture();
+
+    if (pipe(OGLCONSOLE_wakeFds)) return 0;
+
+    fflush(stdout);
+    fflush(stderr);
+
+    for (i = 0; i < 2; i++)
+    {
+        if (pipe(p))
+        {
+            OGLCONSOLE_Uncapture();
+            return 0;
+        }
+
+#ifdef F_SETPIPE_SZ
+        fcntl(p[1], F_SETPIPE_SZ, CAPTURE_PIPE_SIZE);
+#endif
+        fcntl(p[0], F_SETFL, fcntl(p[0], F_GETFL) | O_NONBLOCK);
+
+        OGLCONSOLE_captureFds[i] = p[0];
+        OGLCONSOLE_capturedFds[i] = dup(i + 1);
+        dup2(p[1], i + 1);
+        close(p[1]);
+    }
+
+    OGLCONSOLE_captureConsole = console;
+    OGLCONSOLE_passThrough = passThrough;
+
+    if (!(OGLCONSOLE_captureThread =
+                SDL_CreateThread(OGLCONSOLE_CaptureThread, NULL)))
+    {
+        OGLCONSOLE_Uncapture();
+        return 0;
+    }
+
+    return 1;
+}
+
+/* stdout is fully buffered once it's a pipe, so output printed to it would
+ * show up long after it was printed. Its buffering can't be changed once it
+ * has been used, so instead it's flushed into the pipe every frame */
+static void OGLCONSOLE_FlushCapture(_OGLCONSOLE_Console *console)
+{
+    if (console == OGLCONSOLE_captureConsole)
+        fflush(stdout);
+}
+#else
+#  define OGLCONSOLE_Uncapture()
+#  define OGLCONSOLE_FlushCapture(console)
+#  define OGLCONSOLE_Capture(console, passThrough) 0
+#endif
+
+#if defined(OGLCONSOLE_POSIX) && defined(OGLCONSOLE_THREADS)
+/* A child process runs on a pseudo-terminal, the master end of which a reader
+ * thread polls, reading up to CHILD_READ_SIZE bytes at a time into the
+ * console's queue. While the queue is full, the reader stops reading (looking
+ * again every CHILD_WAIT_MS), so the pty fills up and the child waits in
+ * write(): a child outputting faster than the console takes it is slowed down
+ * to match, rather than its output piling up */
+#define CHILD_READ_SIZE (16 * 1024)
+#define CHILD_WAIT_MS 10
+
+/* Input for a child which its pty won't take right away is kept, up to
+ * MAX_CHILD_INPUT bytes, and tried again every frame */
+#define MAX_CHILD_INPUT (64 * 1024)
+
+extern char **environ;
+
+/* Room left in a console's queue */
+static int OGLCONSOLE_QueueRoom(_OGLCONSOLE_Console *console)
+{
+    int room;
+
+    SDL_mutexP(console->queueLock);
+    room = MAX_QUEUED_OUTPUT - console->queuedLength;
+    SDL_mutexV(console->queueLock);
+
+    return room;
+}
+
+static int OGLCONSOLE_ChildThread(void *data)
+{
+    _OGLCONSOLE_Console *console = data;
+    OGLCONSOLE_Child *child = console->child;
+    char buffer[CHILD_READ_SIZE];
+    struct pollfd fds[2];
+    int reading = 1, room, status;
+
+    fds[1].fd = child->wake[0];
+    fds[0].events = fds[1].events = POLLIN;
+
+    for (;;)
+    {
+        /* Only wait for output while there's room for it */
+        room = reading ? OGLCONSOLE_QueueRoom(console) : 0;
+        fds[0].fd = room > 0 ? child->fd : -1;
+
+        if (poll(fds, 2, room > 0 ? -1 : CHILD_WAIT_MS) < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        /* Told to stop */
+        if (fds[1].revents) break;
+
+        if (fds[0].fd >= 0 && fds[0].revents)
+        {
+            ssize_t n = read(child->fd, buffer, min(room, CHILD_READ_SIZE));
+
+            if (n > 0)
+                OGLCONSOLE_Enqueue(console, buffer, n);
+
+            /* With nothing left with the pty open, reads fail with EIO */
+            else if (n == 0 || (errno != EAGAIN && errno != EINTR))
+                reading = 0;
+        }
+
+        /* Once its output is all read, wait for the child to exit */
+        if (!reading && waitpid(child->pid, &status, WNOHANG) == child->pid)
+        {
+            char message[64];
+            int n = sprintf(message, "\r\n[exited with status %d]\r\n",
+                            WIFEXITED(status) ? WEXITSTATUS(status)
+                                              : 128 + WTERMSIG(status));
+
+            OGLCONSOLE_Enqueue(console, message, n);
+            child->pid = -1;
+
+            SDL_mutexP(console->queueLock);
+            child->exited = 1;
+            SDL_mutexV(console->queueLock);
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/* Stop the reader, and the child process itself if it's still running: it's
+ * hung up on, and killed if it hasn't gone in a little while */
+static void OGLCONSOLE_EndChild(_OGLCONSOLE_Console *console)
+{
+    OGLCONSOLE_Child *child = console->child;
+    int i;
+
+    if (!child) return;
+
+    if (child->thread)
+    {
+        OGLCONSOLE_Wake(child->wake);
+        SDL_WaitThread(child->thread, NULL);
+    }
+
+    if (child->fd >= 0) close(child->fd);
+    if (child->wake[0] >= 0) close(child->wake[0]);
+    if (child->wake[1] >= 0) close(child->wake[1]);
+
+    if (child->pid > 0)
+    {
+        kill(child->pid, SIGHUP);
+
+        for (i = 0; i < 10 && !waitpid(child->pid, NULL, WNOHANG); i++)
+            SDL_Delay(CHILD_WAIT_MS);
+
+        if (i == 10)
+        {
+            kill(child->pid, SIGKILL);
+            waitpid(child->pid, NULL, 0);
+        }
+    }
+
+    free(child->input);
+    free(child);
+    console->child = NULL;
+}
+
+/* Run command with /bin/sh in a child process, on a pseudo-terminal the size
+ * of the console's screen, with its output going to the console */
+static int OGLCONSOLE_Spawn(_OGLCONSOLE_Console *console, const char *command)
+{
+    OGLCONSOLE_Child *child;
+    struct winsize size;
+    char *argv[4], **envp, *name;
+    int i, n, slave;
+
+    OGLCONSOLE_EndChild(console);
+
+    if (!(child = calloc(1, sizeof(OGLCONSOLE_Child)))) return 0;
+
+    child->pid = -1;
+    child->wake[0] = child->wake[1] = -1;
+    console->child = child;
+
+    if ((child->fd = posix_openpt(O_RDWR | O_NOCTTY)) < 0
+     || grantpt(child->fd) || unlockpt(child->fd)
+     || !(name = ptsname(child->fd)) || pipe(child->wake))
+    {
+        OGLCONSOLE_EndChild(console);
+        return 0;
+    }
+
+    for (i = 0; i < 2; i++)
+        fcntl(child->wake[i], F_SETFD, FD_CLOEXEC);
+    fcntl(child->fd, F_SETFD, FD_CLOEXEC);
+    fcntl(child->fd, F_SETFL, fcntl(child->fd, F_GETFL) | O_NONBLOCK);
+
+    memset(&size, 0, sizeof(size));
+    size.ws_col = console->terminal->columns;
+    size.ws_row = console->terminal->rows;
+
+    /* The child's environment is ours, but with TERM saying what we are.
+     * It's made before forking, as only a few things are safe to do in the
+     * child of a program with threads before it execs */
+    for (n = 0; environ[n]; n++);
+    if (!(envp = malloc((n + 2) * sizeof(char*))))
+    {
+        OGLCONSOLE_EndChild(console);
+        return 0;
+    }
+
+    for (i = n = 0; environ[i]; i++)
+        if (strncmp(environ[i], "TERM=", 5))
+            envp[n++] = environ[i];
+    envp[n++] = "TERM=xterm-256color";
+    envp[n] = NULL;
+
+    argv[0] = "sh";
+    argv[1] = "-c";
+    argv[2] = (char*)command;
+    argv[3] = NULL;
+
+    if ((child->pid = fork()) == 0)
+    {
+        /* A session of its own, with the pty as its controlling terminal and
+         * its stdin, stdout and stderr */
+        setsid();
+        if ((slave = open(name, O_RDWR)) < 0) _exit(127);
+#ifdef TIOCSCTTY
+        ioctl(slave, TIOCSCTTY, 0);
+#endif
+        ioctl(slave, TIOCSWINSZ, &size);
+
+        for (i = 0; i < 3; i++)
+            dup2(slave, i);
+        if (slave > 2) close(slave);
+
+        execve("/bin/sh", argv, envp);
+        _exit(127);
+    }
+
+    free(envp);
+
+    if (child->pid < 0
+     || !(child->thread = SDL_CreateThread(OGLCONSOLE_ChildThread, console)))
+    {
+        OGLCONSOLE_EndChild(console);
+        return 0;
+    }
+
+    return 1;
+}
+
+/* Is there a child process running in a console? */
+static int OGLCONSOLE_ChildRunning(_OGLCONSOLE_Console *console)
+{
+    int exited;
+
+    if (!console->child) return 0;
+
+    SDL_mutexP(console->queueLock);
+    exited = console->child->exited;
+    SDL_mutexV(console->queueLock);
+
+    return !exited;
+}
+
+/* Write as much of the input waiting for the child process running in a
+ * console as its pty will take */
+static void OGLCONSOLE_FlushChild(_OGLCONSOLE_Console *console)
+{
+    OGLCONSOLE_Child *child = console->child;
+    ssize_t n;
+
+    if (!child || !child->inputLength) return;
+
+    while (child->inputLength)
+    {
+        if ((n = write(child->fd, child->input, child->inputLength)) < 0)
+        {
+            if (errno == EINTR) continue;
+
+            /* Anything but a full pty means it's never going to be taken */
+            if (errno != EAGAIN)
+                child->inputLength = 0;
+            break;
+        }
+
+        memmove(child->input, child->input + n, child->inputLength - n);
+        child->inputLength -= n;
+    }
+}
+
+/* Send input to the child process running in a console, after whatever input
+ * is still waiting for it. Past MAX_CHILD_INPUT bytes waiting, it's dropped */
+static void OGLCONSOLE_WriteChild(_OGLCONSOLE_Console *console,
+                                  const char *s, int n)
+{
+    OGLCONSOLE_Child *child = console->child;
+
+    if (!OGLCONSOLE_ChildRunning(console)
+     || n > MAX_CHILD_INPUT - child->inputLength
+     || !OGLCONSOLE_Reserve(&child->input, &child->inputSize,
+                            child->inputLength + n, 1))
+        return;
+
+    memcpy(child->input + child->inputLength, s, n);
+    child->inputLength += n;
+
+    OGLCONSOLE_FlushChild(console);
+}
+#else
+#  define OGLCONSOLE_EndChild(console)
+#  define OGLCONSOLE_Spawn(console, command) 0
+#  define OGLCONSOLE_ChildRunning(console) 0
+#  define OGLCONSOLE_FlushChild(console)
+#  define OGLCONSOLE_WriteChild(console, s, n)
+#endif
+
+/* To save code, I've gone with an imperative "modal" kind of interface */
+_OGLCONSOLE_Console *programConsole = NULL;
+
+/* This console is the console currently receiving user input */
+_OGLCONSOLE_Console *userConsole = NULL;
+
+/* Every console there is, so broadcasts can find theirs */
+static _OGLCONSOLE_Console *OGLCONSOLE_consoles = NULL;
+
+/* Broadcast output is kept once, in this block, and every console it goes to
+ * refers to it there */
+static OGLCONSOLE_Block *OGLCONSOLE_sharedBlock = NULL;
+
+/* Set the callback for a console */
+void OGLCONSOLE_EnterKey(void(*cbfun)(OGLCONSOLE_Console console, char *cmd))
+{
+    programConsole->enterKeyCallback = cbfun;
+}
+
+static
+void OGLCONSOLE_DefaultEnterKeyCallback(OGLCONSOLE_Console console, char *cmd)
+{
+    OGLCONSOLE_Output(console,
+            "No enter key callback is registered for this console!\n");
+}
+
+OGLCONSOLE_Console OGLCONSOLE_Create()
+{
+    _OGLCONSOLE_Console *console;
+    GLint viewport[4];
+    int i;
+
+    /* If font hasn't been created, we create it */
+    if (!glIsTexture(OGLCONSOLE_glFontHandle))
+        OGLCONSOLE_CreateFont();
+
+    /* Allocate memory for our console */
+    console = (void*)malloc(sizeof(_OGLCONSOLE_Console));
+ 
+    /* Textual dimensions */
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    console->textWidth = viewport[2] / CHAR_PIXEL_W;
+    console->textHeight = viewport[3] / CHAR_PIXEL_H;
+    screenWidth = (GLdouble)viewport[2] / (GLdouble)CHAR_PIXEL_W;
+    screenHeight = (GLdouble)viewport[3] / (GLdouble)CHAR_PIXEL_H;
+    console->characterWidth = 1.0 / floor(screenWidth);
+    console->characterHeight = 1.0 / floor(screenHeight);
+
+    /* Different values have different meanings for xMatrixUse:
+        0) Do not change the matrix before rendering
+        1) Upload the console's matrix before rendering
+        2) Multiply the console's matrix before rendering */
+
+    /* Initialize its projection matrix */
+    console->pMatrixUse = 1;
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, screenWidth, 0, screenHeight, -1, 1);
+    glGetDoublev(GL_PROJECTION_MATRIX, console->pMatrix);
+    glPopMatrix();
+
+    /* Initialize its modelview matrix */
+    console->mvMatrixUse = 1;
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    glScaled(console->textWidth, console->textHeight, 1);
+    glGetDoublev(GL_MODELVIEW_MATRIX, console->mvMatrix);
+    glPopMatrix();
+
+    /* Screen and scrollback lines */
+    /* This cursor points to what line console output is next destined for */
+    console->lineQueueIndex = 0;
+    console->unindexed = -1;
+    /* Pages of text are only allocated as output reaches them */
+    console->block = OGLCONSOLE_NewBlock();
+    console->file = NULL;
+    console->pages = NULL;
+    console->meta = NULL;
+    console->pageCount = 0;
+    console->outputChannel = -1;
+    console->outputSeverity = OGLCONSOLE_INFO;
+    OGLCONSOLE_ResizeScrollback(console, DEFAULT_MAX_LINES);
+    OGLCONSOLE_StartLine(console, 0);
+    /* This variable represents whether or not a newline has been left */
+    console->outputNewline = 0;
+    /* Repeated lines are output again until the programmer says otherwise */
+    console->coalesce = 0;
+    console->outputColumn = 0;
+    console->view = NULL;
+    console->pendingView = NULL;
+
+    /* ANSI color codes are understood; Quake's could be in ordinary text */
+    console->colorCodes = OGLCONSOLE_COLORS_ANSI;
+    console->ansiColor = console->quakeColor = 0;
+    console->escapeLength = 0;
+    console->terminal = NULL;
+#if defined(OGLCONSOLE_POSIX) && defined(OGLCONSOLE_THREADS)
+    console->child = NULL;
+#endif
+
+    /* No gutter, and every line is shown */
+    console->gutter = console->gutterWidth = 0;
+    console->shownSeverity = OGLCONSOLE_TRACE;
+    console->shownChannels = ~0ul;
+
+    /* Broadcasts only go to consoles which ask for them */
+    console->groups = 0;
+    console->next = (void*)OGLCONSOLE_consoles;
+    OGLCONSOLE_consoles = console;
+
+    /* No rows are pinned */
+    memset(console->pinned, 0, sizeof(console->pinned));
+    console->pinnedCount = 0;
+    console->pinnedTop = 0;
+    console->pinnedLists = 0;
+
+    /* Scrollback lines get display lists once they're drawn */
+    console->lineLists = 0;
+    console->lineTags = NULL;
+    console->lineListCount = 0;
+    console->listGeneration = 0;
+
+    /* Nothing's been planned */
+    console->batches = NULL;
+    console->steps = NULL;
+    console->batchCount = console->batchSize = 0;
+    console->stepCount = console->stepSize = 0;
+    console->plannedFrame = 0;
+
+#ifdef OGLCONSOLE_THREADS
+    /* Nothing's been queued for the console by other threads yet */
+    console->queued = NULL;
+    console->queuedLength = console->queuedSize = 0;
+    console->queueLock = SDL_CreateMutex();
+#endif
+
+    /* Output goes straight into the scrollback */
+    console->backlog = NULL;
+    console->backlogStart = console->backlogLength = console->backlogSize = 0;
+    console->tags = NULL;
+    console->tagStart = console->tagCount = console->tagSize = 0;
+    console->drainBudget = 0;
+    console->drainCost = 0.01;
+    console->recentNext = 0;
+    for (i = 0; i < COALESCE_WINDOW; i++)
+        console->recentLine[i] = -1;
+    /* Output isn't copied anywhere else until the programmer adds sinks */
+    console->sinkCount = 0;
+    console->sinkBlock = 0;
+    console->sinkBuffer = NULL;
+    console->sinkHead = console->sinkTail = 0;
+    console->sinkDropped = 0;
+#ifdef OGLCONSOLE_THREADS
+    console->sinkThread = NULL;
+    console->sinkWork = NULL;
+#endif
+    /* This cursor points to what line the console view is scrolled to */
+    console->lineScrollIndex = 0;
+    console->rowScrollIndex = 0;
+    console->scrollFraction = console->scrollAhead = 0;
+    console->scrollVelocity = 0;
+    console->scrollTicks = 0;
+
+    /* Initialize the user's input (command line) */
+    console->inputLineLength = 0;
+    console->inputCursorPos = 0;
+    console->inputLine[0] = '\0';
+
+    /* History lines */
+    memset(console->history, 0, MAX_INPUT_LENGTH * MAX_HISTORY_COUNT);
+    console->historyQueueIndex = 0;
+    console->historyScrollIndex = -1;
+
+    /* Callbacks */
+    console->enterKeyCallback = OGLCONSOLE_DefaultEnterKeyCallback;
+
+    /* Tagged output filter */
+    for (i = 0; i < OGLCONSOLE_SEVERITIES; i++)
+        console->filter.mask[i] = i >= DEFAULT_MIN_SEVERITY ? ~0ul : 0;
+
+    /* The console starts life invisible */
+    console->visible = 0;
+    console->transitionComplete = 0;
+
+    /* If no consoles existed before, we select this one for convenience */
+    if (!programConsole) programConsole = console;
+    if (!userConsole) userConsole = console;
+
+
+
+
+    /* Temporary shit */
+    OGLCONSOLE_Output((void*)console, "Console initialized\n");
+
+    OGLCONSOLE_Output((void*)console,
+            "Console display lines:\t\t%i\n", console->textHeight);
+
+    OGLCONSOLE_Output((void*)console,
+            "Console display columns:\t%i\n", console->textWidth);
+
+    OGLCONSOLE_Output((void*)console,
+            "Console input length:\t\t%i\n", MAX_INPUT_LENGTH);
+
+
+    /* Return the opaque pointer to the programmer */
+    return (OGLCONSOLE_Console)console;
+}
+
+/* Give back the display lists of a console's scrollback lines */
+static void OGLCONSOLE_FreeLineLists(_OGLCONSOLE_Console *console)
+{
+    if (console->lineLists)
+        glDeleteLists(console->lineLists, console->lineListCount);
+    free(console->lineTags);
+
+    console->lineLists = 0;
+    console->lineTags = NULL;
+    console->lineListCount = 0;
+}
+
+/* This functoin is only used internally; the user ultimately invokes this
+ * function through either a call to Destroy() or Quit(); the purpose of this
+ * mechanism is to warn the user if he has explicitly destroyed a console that
+ * was engaged in operation at the time they destroyed it (the only two
+ * operations a console can be engaged in are receiving programmer interaction,
+ * or receiving end-user interaction. fyi, "user" always refers to the
+ * programmer, end-user refers to the real end-user) */
+static void OGLCONSOLE_DestroyReal(OGLCONSOLE_Console console, int safe)
+{
+    _OGLCONSOLE_Console **c;
+    int p;
+
+    for (c = &OGLCONSOLE_consoles; *c; c = (void*)&(*c)->next)
+        if (*c == C)
+        {
+            *c = (void*)C->next;
+            break;
+        }
+
+    /* Stop any program running in it, and capturing into it */
+    OGLCONSOLE_EndChild(C);
+
+#if defined(OGLCONSOLE_POSIX) && defined(OGLCONSOLE_THREADS)
+    if (OGLCONSOLE_captureConsole == C)
+        OGLCONSOLE_Uncapture();
+#endif
+
+    /* Put the last of its output into the scrollback, so that it reaches the
+     * sinks, and finish writing to them */
+    OGLCONSOLE_DrainQueue(C);
+    OGLCONSOLE_CloseSinks(C);
+
+    /* Stop scanning */
+    OGLCONSOLE_FreeView(C->pendingView);
+    OGLCONSOLE_FreeView(C->view);
+
+#ifdef OGLCONSOLE_THREADS
+    free(C->queued);
+    if (C->queueLock)
+        SDL_DestroyMutex(C->queueLock);
+#endif
+    free(C->backlog);
+    free(C->tags);
+    OGLCONSOLE_FreeTerminal(C->terminal);
+
+    if (C->pinnedLists)
+        glDeleteLists(C->pinnedLists, MAX_PINNED_ROWS);
+    OGLCONSOLE_FreeLineLists(C);
+
+    for (p = 0; p < C->batchSize; p++)
+        if (C->batches[p])
+        {
+            free(C->batches[p]->text);
+            free(C->batches[p]->runs);
+            free(C->batches[p]->quads);
+            free(C->batches[p]);
+        }
+    free(C->batches);
+    free(C->steps);
+
+    /* Return scrollback pages to the pool */
+    for (p = 0; p < C->pageCount; p++)
+    {
+        OGLCONSOLE_FreeLines(C->pages[p]);
+        OGLCONSOLE_FreeMeta(C->meta[p]);
+    }
+    free(C->pages);
+    free(C->meta);
+    OGLCONSOLE_ReleaseBlock(C->block);
+    OGLCONSOLE_CloseFile(C->file);
+
+    free(C);
+
+    if (safe)
+    {
+        if (programConsole == C)
+        {
+            fprintf(stderr, 
+            "Warning: OGLCONSOLE you just destroyed the programConsole!\n");
+            programConsole = NULL;
+        }
+
+        if (userConsole == C)
+        {
+            fprintf(stderr,
+            "Warning: OGLCONSOLE you just destroyed the userConsole!\n");
+            userConsole = NULL;
+        }
+    }
+}
+
+/* The user can call this function to free a console. A warning is printed to
+ * stderr if the user has destroyed a console destroyed while it was receiving
+ * input, see DestroyReal() for details TODO: there are currently no semantics
+ * under consideration for explicitly destroying an 'engaged' console WITHOUT
+ * having a warning issued, nor is there a way to deselect a console without
+ * also selecting a new one as of yet */
+void OGLCONSOLE_Destroy(OGLCONSOLE_Console console)
+{
+    OGLCONSOLE_DestroyReal(console, 1);
+}
+
+static void OGLCONSOLE_StopBuilding();
+
+/* This function frees all of the consoles that the library is actively aware
+ * of, which is every console that hasn't been destroyed, before what they
+ * share; no warnings are issued by this function */
+void OGLCONSOLE_Quit()
+{
+    while (OGLCONSOLE_consoles)
+        OGLCONSOLE_DestroyReal((void*)OGLCONSOLE_consoles, 0);
+
+    programConsole = NULL;
+    userConsole = NULL;
+
+    OGLCONSOLE_SealBlock(OGLCONSOLE_sharedBlock);
+    OGLCONSOLE_ReleaseBlock(OGLCONSOLE_sharedBlock);
+    OGLCONSOLE_sharedBlock = NULL;
+
+    OGLCONSOLE_FreeBlocks();
+    OGLCONSOLE_StopBuilding();
+
+#ifdef OGLCONSOLE_THREADS
+    if (OGLCONSOLE_storageLock)
+    {
+        SDL_DestroyMutex(OGLCONSOLE_storageLock);
+        OGLCONSOLE_storageLock = NULL;
+    }
+#endif
+}
+
+/* THESE TWO FUNCTIONS EditConsole() and FocusConsole...
+
+ * function is intended for use by applications which create MORE THAN ONE
+ * console, since every newly created console is automatically selected for
+ * programmer input ('programmer input' refers to calling any function which
+ * does not specify a console explicitly in its parameter list. the console
+ * which is 'engaged' by 'programmer input' at the time of calling one of these
+ * functions is the console that function will operate on */
+
+/* This routine selects a console to receive keyboard interaction from the user */
+void OGLCONSOLE_FocusConsole(OGLCONSOLE_Console console) { userConsole = C; }
+
+/* This routine selects a console to be the target of modification commands from
+ * the programmer */
+void OGLCONSOLE_EditConsole(OGLCONSOLE_Console console) { programConsole = C; }
+
+/* Show or hide a console */
+void OGLCONSOLE_SetVisibility(int visible)
+{
+    programConsole->visible = visible ? -1 : 0;
+}
+/* Query console visibility */
+int OGLCONSOLE_GetVisibility() {
+    return programConsole->visible;
+}
+
+/* Get current configuration information about a console */
+void OGLCONSOLE_Info()
 {
     puts("TODO: print some console info here");
 }
 
-/* This routine is meant for applications with a single console, if you use
- * multiple consoles in your program, use Render() instead */
-void OGLCONSOLE_Draw() { OGLCONSOLE_Render((void*)userConsole); }
+/* This routine is meant for applications with a single console, if you use
+ * multiple consoles in your program, use Render() instead */
+void OGLCONSOLE_Draw() { OGLCONSOLE_Render((void*)userConsole); }
+
+/* Format the variables watched by a console's pinned rows, those which are due
+ * to be looked at and have changed */
+static void OGLCONSOLE_SampleWatches(_OGLCONSOLE_Console *console)
+{
+    static const int size[] = { sizeof(int), sizeof(long), sizeof(float),
+                                sizeof(double) };
+    unsigned int now = SDL_GetTicks();
+    OGLCONSOLE_Pin *pin;
+    int i, n;
+
+    for (i = 0; i < console->pinnedCount; i++)
+    {
+        pin = console->pinned + i;
+
+        if (!pin->variable || (int)(now - pin->next) < 0) continue;
+        pin->next = now + pin->interval;
+
+        if (pin->sampled && !memcmp(&pin->last, pin->variable, size[pin->type]))
+            continue;
+        memcpy(&pin->last, pin->variable, size[pin->type]);
+        pin->sampled = 1;
+
+        switch (pin->type)
+        {
+            case OGLCONSOLE_WATCH_INT:
+                n = snprintf(pin->text, PINNED_LENGTH, pin->format, pin->last.i);
+                break;
+            case OGLCONSOLE_WATCH_LONG:
+                n = snprintf(pin->text, PINNED_LENGTH, pin->format, pin->last.l);
+                break;
+            case OGLCONSOLE_WATCH_FLOAT:
+                n = snprintf(pin->text, PINNED_LENGTH, pin->format, pin->last.f);
+                break;
+            default:
+                n = snprintf(pin->text, PINNED_LENGTH, pin->format, pin->last.d);
+                break;
+        }
+
+        pin->length = max(0, min(n, PINNED_LENGTH - 1));
+        pin->dirty = 1;
+    }
+}
+
+/* Text is drawn as quads from arrays of vertices which are each a texture
+ * coordinate and then a position. That's four floats, so a vertex fits in a
+ * SIMD register */
+
+/* The texture coordinates of each glyph's four corners, with a space after
+ * each for where the corner goes */
+static float OGLCONSOLE_glyphQuads[256][16];
+
+static void OGLCONSOLE_InitGlyphs()
+{
+    int c;
+
+    if (OGLCONSOLE_glyphQuads[1][0]) return;
+
+    for (c = 0; c < 256; c++)
+    {
+        float *q = OGLCONSOLE_glyphQuads[c];
+        float cx = (c % 16) * CHAR_WIDTH, cX = cx + CHAR_WIDTH,
+              cY = (c / 16) * CHAR_HEIGHT, cy = cY + CHAR_HEIGHT;
+
+        q[0] = cx; q[1] = cy;
+        q[4] = cX; q[5] = cy;
+        q[8] = cX; q[9] = cY;
+        q[12] = cx; q[13] = cY;
+    }
+}
+
+/* Put the vertices of n glyphs into quads, the first glyph at x, y and each
+ * one w to the right of the last. A glyph's vertices are its corners from
+ * the table plus where they go; glyph i's left edge is x + i * w and its
+ * right edge is the next one's left edge, so neighbours meet exactly */
+static void OGLCONSOLE_RowQuads(const unsigned char *s, int n, float x,
+                                float y, float w, float h, float *quads)
+{
+    int i;
+#if defined(__SSE2__)
+    const __m128 origin = _mm_setr_ps(0, 0, x, y),
+                 step = _mm_setr_ps(0, 0, w, 0),
+                 up = _mm_setr_ps(0, 0, 0, h);
+    __m128 left = origin, right;
+
+    for (i = 0; i < n; i++, quads += 16)
+    {
+        const float *q = OGLCONSOLE_glyphQuads[s[i]];
+
+        right = _mm_add_ps(origin, _mm_mul_ps(_mm_set1_ps(i + 1), step));
+
+        _mm_storeu_ps(quads, _mm_add_ps(_mm_loadu_ps(q), left));
+        _mm_storeu_ps(quads + 4, _mm_add_ps(_mm_loadu_ps(q + 4), right));
+        _mm_storeu_ps(quads + 8, _mm_add_ps(_mm_loadu_ps(q + 8),
+                                            _mm_add_ps(right, up)));
+        _mm_storeu_ps(quads + 12, _mm_add_ps(_mm_loadu_ps(q + 12),
+                                             _mm_add_ps(left, up)));
+        left = right;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const float o[4] = { 0, 0, x, y }, st[4] = { 0, 0, w, 0 },
+                u[4] = { 0, 0, 0, h };
+    const float32x4_t origin = vld1q_f32(o), step = vld1q_f32(st),
+                      up = vld1q_f32(u);
+    float32x4_t left = origin, right;
+
+    for (i = 0; i < n; i++, quads += 16)
+    {
+        const float *q = OGLCONSOLE_glyphQuads[s[i]];
+
+        right = vaddq_f32(origin, vmulq_n_f32(step, i + 1));
+
+        vst1q_f32(quads, vaddq_f32(vld1q_f32(q), left));
+        vst1q_f32(quads + 4, vaddq_f32(vld1q_f32(q + 4), right));
+        vst1q_f32(quads + 8, vaddq_f32(vld1q_f32(q + 8),
+                                       vaddq_f32(right, up)));
+        vst1q_f32(quads + 12, vaddq_f32(vld1q_f32(q + 12),
+                                        vaddq_f32(left, up)));
+        left = right;
+    }
+#else
+    for (i = 0; i < n; i++, quads += 16)
+    {
+        const float *q = OGLCONSOLE_glyphQuads[s[i]];
+        float left = x + i * w, right = x + (i + 1) * w;
+
+        memcpy(quads, q, 16 * sizeof(float));
+        quads[2] = left;   quads[3] = y;
+        quads[6] = right;  quads[7] = y;
+        quads[10] = right; quads[11] = y + h;
+        quads[14] = left;  quads[15] = y + h;
+    }
+#endif
+}
+
+/* Set the color text is drawn in, 0 being the usual green */
+static void OGLCONSOLE_TextColor(unsigned int color)
+{
+    if (color)
+        glColor3ub(color >> 16, color >> 8 & 0xff, color & 0xff);
+    else
+        glColor3d(0,1,0);
+}
+
+/* Make room for need things of size bytes at *p, which has room for *size */
+static int OGLCONSOLE_Reserve(void *p, int *size, int need, size_t bytes)
+{
+    void *grown;
+    int n = max(*size, 16);
+
+    if (need <= *size) return 1;
+
+    while (n < need) n *= 2;
+    if (!(grown = realloc(*(void**)p, n * bytes))) return 0;
+
+    *(void**)p = grown;
+    *size = n;
+    return 1;
+}
+
+/* Add a step to a console's plan for the frame. Returns NULL if there's no
+ * memory for it */
+static OGLCONSOLE_Step *OGLCONSOLE_PlanStep(_OGLCONSOLE_Console *console,
+                                            int type, GLuint list, double y)
+{
+    OGLCONSOLE_Step *step;
+
+    if (!OGLCONSOLE_Reserve(&console->steps, &console->stepSize,
+                            console->stepCount + 1, sizeof(OGLCONSOLE_Step)))
+        return NULL;
+
+    step = console->steps + console->stepCount++;
+    step->type = type;
+    step->batch = NULL;
+    step->list = list;
+    step->y = y;
+    step->height = 0;
+    return step;
+}
+
+/* Start a batch of text for the frame, which is compiled into list, or drawn
+ * as it is if list is 0. Batches are kept from frame to frame, with their
+ * memory. Returns NULL if there's no memory for it */
+static OGLCONSOLE_Batch *OGLCONSOLE_PlanBatch(_OGLCONSOLE_Console *console,
+                                              GLuint list)
+{
+    OGLCONSOLE_Batch *batch;
+    OGLCONSOLE_Step *step;
+    int size = console->batchSize;
+
+    if (!OGLCONSOLE_Reserve(&console->batches, &console->batchSize,
+                            console->batchCount + 1,
+                            sizeof(OGLCONSOLE_Batch*)))
+        return NULL;
+    while (size < console->batchSize)
+        console->batches[size++] = NULL;
+
+    if (!(batch = console->batches[console->batchCount])
+     && !(batch = console->batches[console->batchCount] =
+                  calloc(1, sizeof(OGLCONSOLE_Batch))))
+        return NULL;
+
+    if (!(step = OGLCONSOLE_PlanStep(console, list ? STEP_COMPILE : STEP_DRAW,
+                                     list, 0)))
+        return NULL;
+
+    console->batchCount++;
+    step->batch = batch;
+
+    batch->length = batch->runCount = batch->built = 0;
+    batch->w = console->characterWidth;
+    batch->h = console->characterHeight;
+    return batch;
+}
+
+/* Add n characters of text to a batch, the first at x, y, in color (0 being
+ * the usual green). The text is copied, since it may not last the frame */
+static void OGLCONSOLE_BatchText(OGLCONSOLE_Batch *batch, const char *s,
+                                 int n, double x, double y,
+                                 unsigned int color)
+{
+    OGLCONSOLE_Run *run;
+
+    if (!batch || n <= 0
+     || !OGLCONSOLE_Reserve(&batch->text, &batch->textSize,
+                            batch->length + n, 1)
+     || !OGLCONSOLE_Reserve(&batch->runs, &batch->runSize,
+                            batch->runCount + 1, sizeof(OGLCONSOLE_Run)))
+        return;
+
+    run = batch->runs + batch->runCount++;
+    run->start = batch->length;
+    run->length = n;
+    run->x = x;
+    run->y = y;
+    run->color = color;
+
+    memcpy(batch->text + batch->length, s, n);
+    batch->length += n;
+}
+
+/* Make the quads for a batch's text in an array of size floats, growing it
+ * as needed. Returns the array, or NULL if it couldn't be grown. This doesn't
+ * touch the GL, or anything but the batch and the array, so it can be done on
+ * any thread */
+static float *OGLCONSOLE_MakeQuads(OGLCONSOLE_Batch *batch, float **quads,
+                                   int *size)
+{
+    OGLCONSOLE_Run *run;
+    int i;
+
+    if (!OGLCONSOLE_Reserve(quads, size, batch->length * 16, sizeof(float)))
+        return NULL;
+
+    for (i = 0, run = batch->runs; i < batch->runCount; i++, run++)
+        OGLCONSOLE_RowQuads((const unsigned char*)batch->text + run->start,
+                            run->length, run->x, run->y, batch->w, batch->h,
+                            *quads + run->start * 16);
+
+    return *quads;
+}
+
+/* Make the quads for a batch's text and keep them with it, for Prepare() */
+static void OGLCONSOLE_BuildBatch(OGLCONSOLE_Batch *batch)
+{
+    if (!OGLCONSOLE_MakeQuads(batch, &batch->quads, &batch->quadSize))
+        batch->runCount = 0;
+    batch->built = 1;
+}
+
+/* Issue rendering commands for a batch whose quads have been made, a draw per
+ * color */
+static void OGLCONSOLE_DrawBatch(OGLCONSOLE_Batch *batch, float *quads)
+{
+    OGLCONSOLE_Run *runs = batch->runs;
+    int i, j;
+
+    if (!quads || !batch->runCount) return;
+
+    glTexCoordPointer(2, GL_FLOAT, 4 * sizeof(float), quads);
+    glVertexPointer(2, GL_FLOAT, 4 * sizeof(float), quads + 2);
+
+    for (i = 0; i < batch->runCount; i = j)
+    {
+        for (j = i + 1; j < batch->runCount && runs[j].color == runs[i].color;
+             j++);
+
+        OGLCONSOLE_TextColor(runs[i].color);
+        glDrawArrays(GL_QUADS, runs[i].start * 4,
+                (runs[j - 1].start + runs[j - 1].length - runs[i].start) * 4);
+    }
+}
+
+/* Without Prepare(), each batch's quads are made just before they're drawn,
+ * all of them in this one array */
+static float *OGLCONSOLE_drawQuads = NULL;
+static int OGLCONSOLE_drawQuadSize = 0;
+
+/* Prepare() counts frames, and a console's plan is good for the frame it was
+ * made in */
+static unsigned int OGLCONSOLE_frame = 1;
+
+/* Batches waiting to be built by Prepare(), and the next to be taken */
+static OGLCONSOLE_Batch **OGLCONSOLE_buildQueue = NULL;
+static int OGLCONSOLE_buildCount = 0, OGLCONSOLE_buildSize = 0,
+           OGLCONSOLE_buildNext = 0;
+
+/* Build batches from the queue until there are none left to take */
+static void OGLCONSOLE_BuildQueued()
+{
+    int i;
+
+    while ((i = __sync_fetch_and_add(&OGLCONSOLE_buildNext, 1))
+         < OGLCONSOLE_buildCount)
+        OGLCONSOLE_BuildBatch(OGLCONSOLE_buildQueue[i]);
+}
+
+#ifdef OGLCONSOLE_THREADS
+/* The build threads, which sleep until there's a queue of batches to build,
+ * and say when they've run out */
+static SDL_Thread *OGLCONSOLE_builders[MAX_BUILD_THREADS];
+static SDL_sem *OGLCONSOLE_buildWork = NULL, *OGLCONSOLE_buildDone = NULL;
+static int OGLCONSOLE_builderCount = -1, OGLCONSOLE_buildQuit = 0;
+
+/* How many threads to build on, the GL thread included; 0 for one per CPU */
+static int OGLCONSOLE_buildThreads = 0;
+
+static int OGLCONSOLE_BuildThread(void *unused)
+{
+    for (;;)
+    {
+        SDL_SemWait(OGLCONSOLE_buildWork);
+        if (OGLCONSOLE_buildQuit) return 0;
+
+        OGLCONSOLE_BuildQueued();
+        SDL_SemPost(OGLCONSOLE_buildDone);
+    }
+}
+
+/* Start the build threads, one fewer than there are to be since the GL
+ * thread builds too */
+static void OGLCONSOLE_StartBuilding()
+{
+    int threads = OGLCONSOLE_buildThreads;
+
+    OGLCONSOLE_builderCount = 0;
+
+#ifdef OGLCONSOLE_POSIX
+    if (!threads)
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    threads = max(1, min(threads, MAX_BUILD_THREADS));
+    if (threads < 2) return;
+
+    OGLCONSOLE_buildWork = SDL_CreateSemaphore(0);
+    OGLCONSOLE_buildDone = SDL_CreateSemaphore(0);
+    if (!OGLCONSOLE_buildWork || !OGLCONSOLE_buildDone) return;
+
+    while (OGLCONSOLE_builderCount < threads - 1
+        && (OGLCONSOLE_builders[OGLCONSOLE_builderCount] =
+                SDL_CreateThread(OGLCONSOLE_BuildThread, NULL)))
+        OGLCONSOLE_builderCount++;
+}
+
+static void OGLCONSOLE_StopBuilding()
+{
+    int i;
+
+    OGLCONSOLE_buildQuit = 1;
+    for (i = 0; i < OGLCONSOLE_builderCount; i++)
+        SDL_SemPost(OGLCONSOLE_buildWork);
+    for (i = 0; i < OGLCONSOLE_builderCount; i++)
+        SDL_WaitThread(OGLCONSOLE_builders[i], NULL);
+
+    if (OGLCONSOLE_buildWork) SDL_DestroySemaphore(OGLCONSOLE_buildWork);
+    if (OGLCONSOLE_buildDone) SDL_DestroySemaphore(OGLCONSOLE_buildDone);
+    OGLCONSOLE_buildWork = OGLCONSOLE_buildDone = NULL;
+    OGLCONSOLE_builderCount = -1;
+    OGLCONSOLE_buildQuit = 0;
+
+    free(OGLCONSOLE_buildQueue);
+    OGLCONSOLE_buildQueue = NULL;
+    OGLCONSOLE_buildSize = 0;
+
+    free(OGLCONSOLE_drawQuads);
+    OGLCONSOLE_drawQuads = NULL;
+    OGLCONSOLE_drawQuadSize = 0;
+}
+#else
+static void OGLCONSOLE_StopBuilding()
+{
+    free(OGLCONSOLE_buildQueue);
+    OGLCONSOLE_buildQueue = NULL;
+    OGLCONSOLE_buildSize = 0;
+
+    free(OGLCONSOLE_drawQuads);
+    OGLCONSOLE_drawQuads = NULL;
+    OGLCONSOLE_drawQuadSize = 0;
+}
+#endif
+
+/* How many build threads there are to help, starting them the first time */
+static int OGLCONSOLE_Builders()
+{
+#ifdef OGLCONSOLE_THREADS
+    if (OGLCONSOLE_builderCount < 0)
+        OGLCONSOLE_StartBuilding();
+
+    return OGLCONSOLE_builderCount;
+#else
+    return 0;
+#endif
+}
+
+/* Build the batches in the queue with the build threads' help */
+static void OGLCONSOLE_BuildAll()
+{
+#ifdef OGLCONSOLE_THREADS
+    int i;
+#endif
+
+    OGLCONSOLE_buildNext = 0;
+
+#ifdef OGLCONSOLE_THREADS
+    for (i = 0; i < OGLCONSOLE_builderCount; i++)
+        SDL_SemPost(OGLCONSOLE_buildWork);
+#endif
+
+    OGLCONSOLE_BuildQueued();
+
+#ifdef OGLCONSOLE_THREADS
+    for (i = 0; i < OGLCONSOLE_builderCount; i++)
+        SDL_SemWait(OGLCONSOLE_buildDone);
+#endif
+}
+
+/* Put n characters of a line from column on into a batch, in the colors its
+ * spans give it, or else color (0 for the usual green), as a run per span */
+static void OGLCONSOLE_PlanColored(_OGLCONSOLE_Console *console,
+                                   OGLCONSOLE_Batch *batch, long line,
+                                   OGLCONSOLE_Meta *meta, const char *text,
+                                   int column, int n, double x, double y,
+                                   unsigned int color)
+{
+    OGLCONSOLE_Span *spans = NULL;
+    int i, count = 0, end = column + n;
+
+    if (meta)
+    {
+        spans = meta->spans + meta->spanStart[line % LINES_PER_PAGE];
+        count = meta->spanCount[line % LINES_PER_PAGE];
+    }
+
+    /* Find the color at column */
+    for (i = 0; i < count && spans[i].column <= column; i++);
+
+    while (column < end)
+    {
+        unsigned int c = i && spans[i - 1].color ? spans[i - 1].color : color;
+        int next = i < count ? min(spans[i].column, end) : end;
+
+        OGLCONSOLE_BatchText(batch, text + column, next - column, x, y, c);
+
+        x += (next - column) * console->characterWidth;
+        column = next;
+        i++;
+    }
+}
+
+/* Put rows from to to - 1 of a line as it's wrapped into a batch, with row
+ * from at y and the rest going down the display */
+static void OGLCONSOLE_PlanLine(_OGLCONSOLE_Console *console,
+                                OGLCONSOLE_Batch *batch, long line,
+                                int from, int to, double y)
+{
+    static char buffer[MAX_LINE_LENGTH + 16];
+    OGLCONSOLE_Meta *meta = OGLCONSOLE_LineMeta(console, line);
+    unsigned int color = meta ? meta->color[line % LINES_PER_PAGE] : 0;
+    int row, length, columns = OGLCONSOLE_Columns(console);
+    const char *text = OGLCONSOLE_DisplayText(console, line, buffer, &length);
+
+    /* The gutter goes beside a line's first row, in grey */
+    if (console->gutter && from == 0)
+    {
+        char gutter[32];
+
+        OGLCONSOLE_Gutter(console, line, gutter);
+        OGLCONSOLE_BatchText(batch, gutter, console->gutterWidth, 0, y,
+                             0x808080);
+    }
+
+    for (row = from; row < to; row++, y -= console->characterHeight)
+        OGLCONSOLE_PlanColored(console, batch, line, meta, text, row * columns,
+                min(length - row * columns, columns),
+                console->gutterWidth * console->characterWidth, y, color);
+}
+
+/* Returns the display list which draws all rows rows of a scrollback line,
+ * its last row at the origin and the others above it, planning to compile it
+ * first if its slot holds another line or is stale. Returns 0 for the line
+ * still being output to, which changes too often to be worth it, and if
+ * there are no lists to be had */
+static GLuint OGLCONSOLE_LineList(_OGLCONSOLE_Console *console, long line,
+                                  int rows)
+{
+    int count = LINE_LIST_SCREENS * console->textHeight, length, repeats, i;
+    OGLCONSOLE_ListTag *tag;
+    OGLCONSOLE_Batch *batch;
+
+    if (line == console->lineQueueIndex) return 0;
+
+    /* There have to be enough slots for every line on the display, and some
+     * to scroll back to */
+    if (console->lineListCount != count)
+    {
+        OGLCONSOLE_FreeLineLists(console);
+
+        if (!(console->lineTags = malloc(count * sizeof(OGLCONSOLE_ListTag)))
+         || !(console->lineLists = glGenLists(count)))
+        {
+            OGLCONSOLE_FreeLineLists(console);
+            return 0;
+        }
+
+        console->lineListCount = count;
+        for (i = 0; i < count; i++)
+            console->lineTags[i].line = -1;
+    }
+
+    /* Lines before the current one only ever change by being repeated */
+    length = OGLCONSOLE_LineLength(console, line);
+    repeats = OGLCONSOLE_Repeats(console, line);
+    i = line % count;
+    tag = console->lineTags + i;
+
+    if (tag->line != line || tag->length != length || tag->repeats != repeats
+     || tag->generation != console->listGeneration)
+    {
+        if (!(batch = OGLCONSOLE_PlanBatch(console, console->lineLists + i)))
+            return 0;
+
+        OGLCONSOLE_PlanLine(console, batch, line, 0, rows,
+                            (rows - 1) * console->characterHeight);
+
+        tag->line = line;
+        tag->length = length;
+        tag->repeats = repeats;
+        tag->generation = console->listGeneration;
+    }
+
+    return console->lineLists + i;
+}
+
+/* Plan the scrollback up from the command line, ending at the line and row
+ * it's scrolled to. Lines which fit on the display whole are drawn from their
+ * display lists; only those cut off at the top or bottom go into screen, the
+ * batch drawn as it is, and only the rows of them that show. Part way through
+ * a row of smooth scrolling, everything is shifted down by part of a row and
+ * clipped to the scrollback's rows, and the lines cut off are drawn whole
+ * from their display lists too, so only the lines scrolled onto the display
+ * are built while it moves */
+static void OGLCONSOLE_PlanScrollback(_OGLCONSOLE_Console *console,
+                                      OGLCONSOLE_Batch *screen)
+{
+    /* Graphical line, and scrollback line and which of its wrapped rows
+     * we're drawing; pinned rows take some of the graphical lines, and a
+     * shifted display shows part of one more at the top */
+    int gLine, tRow, top, count, n,
+        rows = console->textHeight - console->pinnedCount,
+        below = console->pinnedTop ? 0 : console->pinnedCount,
+        topLine = console->scrollFraction ? -1 : 0;
+    long tLine = console->lineScrollIndex,
+         first = OGLCONSOLE_FirstLine(console);
+    double y, h = console->characterHeight,
+           shift = console->scrollFraction * h;
+    OGLCONSOLE_Step *clip;
+    GLuint list;
+
+    count = OGLCONSOLE_Rows(console, tLine);
+    tRow = max(0, count - 1 - console->rowScrollIndex);
+
+    /* Everything drawn from here is clipped, the cut off lines which have no
+     * display list included, so they go in a batch of their own */
+    if (shift)
+    {
+        if ((clip = OGLCONSOLE_PlanStep(console, STEP_CLIP, 0,
+                                        (below + 1) * h)))
+            clip->height = rows * h;
+        screen = OGLCONSOLE_PlanBatch(console, 0);
+    }
+
+    /* Iterate through each line being displayed, from the bottom up; only
+     * the lines which end up on screen ever get wrapped */
+    for (gLine = rows - 1; gLine >= topLine && tLine >= first; gLine -= n)
+    {
+        /* Rows top to tRow of this line show, tRow at graphical line gLine */
+        top = max(0, tRow - (gLine - topLine));
+        n = tRow - top + 1;
+        y = (rows - gLine + below) * h - shift;
+
+        if ((shift || (top == 0 && tRow == count - 1))
+         && (list = OGLCONSOLE_LineList(console, tLine, count)))
+            OGLCONSOLE_PlanStep(console, STEP_CALL, list,
+                                y - (count - 1 - tRow) * h);
+        else
+            OGLCONSOLE_PlanLine(console, screen, tLine, top, tRow + 1,
+                                y + (n - 1) * h);
+
+        /* Move up to the line above */
+        tLine = OGLCONSOLE_ShownBy(console, tLine - 1);
+        tRow = (count = OGLCONSOLE_Rows(console, tLine)) - 1;
+    }
+
+    if (shift)
+        OGLCONSOLE_PlanStep(console, STEP_CLIP, 0, 0);
+}
+
+/* A hash of a row of a terminal's screen, a word at a time */
+static unsigned long long OGLCONSOLE_RowHash(const char *cells,
+                                             const unsigned int *colors,
+                                             int n)
+{
+    unsigned long long h = 0xcbf29ce484222325ull, word;
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        memcpy(&word, cells + i, 8);
+        h = (h ^ word) * 0x100000001b3ull;
+    }
+    for (; i < n; i++)
+        h = (h ^ (unsigned char)cells[i]) * 0x100000001b3ull;
+
+    for (i = 0; i + 2 <= n; i += 2)
+    {
+        memcpy(&word, colors + i, 8);
+        h = (h ^ word) * 0x100000001b3ull;
+    }
+    if (i < n)
+        h = (h ^ colors[i]) * 0x100000001b3ull;
+
+    return h;
+}
+
+/* Is row r of the screen what row front of its display lists draws? */
+static int OGLCONSOLE_SameRow(OGLCONSOLE_Terminal *t, int r, int front)
+{
+    int w = t->columns;
+
+    return t->backHashes[r] == t->frontHashes[front]
+        && !memcmp(t->cells + r * w, t->frontCells + front * w, w)
+        && !memcmp(t->colors + r * w, t->frontColors + front * w,
+                   w * sizeof(unsigned int));
+}
+
+/* Move rows from up to to of the front of the screen, and their display
+ * lists, up by k rows (down if k is negative), the ones pushed out of the way
+ * going round to the other end */
+static int OGLCONSOLE_RotateFront(OGLCONSOLE_Terminal *t, int from, int to,
+                                  int k)
+{
+    struct { void *base; int size; } parts[] =
+    {
+        { t->frontCells, t->columns },
+        { t->frontColors, t->columns * sizeof(unsigned int) },
+        { t->frontHashes, sizeof(unsigned long long) },
+        { t->rowLists, sizeof(GLuint) }
+    };
+    char *temp = malloc(abs(k) * parts[1].size);
+    int i;
+
+    if (!temp) return 0;
+
+    for (i = 0; i < 4; i++)
+    {
+        char *base = parts[i].base;
+        int size = parts[i].size, n = abs(k) * size,
+            rest = (to - from) * size - n;
+
+        if (k > 0)
+        {
+            memcpy(temp, base + from * size, n);
+            memmove(base + from * size, base + from * size + n, rest);
+            memcpy(base + from * size + rest, temp, n);
+        }
+        else
+        {
+            memcpy(temp, base + from * size + rest, n);
+            memmove(base + from * size + n, base + from * size, rest);
+            memcpy(base + from * size, temp, n);
+        }
+    }
+
+    free(temp);
+    memset(t->dirty + from, 1, to - from);
+    return 1;
+}
+
+/* Bring the front of a terminal's screen, and its display lists (once the
+ * frame's batches are compiled), up to date with the screen. Only rows
+ * written to are looked at, and only those which have changed are rebuilt.
+ * When the screen (or a scrolling region) has scrolled, the rows which have
+ * moved keep their display lists, and only the rows scrolled in are rebuilt.
+ * Returns 0 if there's no memory for it */
+static int OGLCONSOLE_UpdateFront(_OGLCONSOLE_Console *console)
+{
+    OGLCONSOLE_Terminal *t = console->terminal;
+    OGLCONSOLE_Batch *batch;
+    int w = t->columns, rows = t->rows, r, r0, k, n, best, shift = 0;
+
+    /* Start again when the screen changes size */
+    if (t->listColumns != w || t->listRows != rows)
+    {
+        OGLCONSOLE_FreeFront(t);
+
+        t->frontCells = calloc(rows, w);
+        t->frontColors = calloc(rows, w * sizeof(unsigned int));
+        t->frontHashes = calloc(rows, sizeof(unsigned long long));
+        t->backHashes = calloc(rows, sizeof(unsigned long long));
+        t->rowLists = malloc(rows * sizeof(GLuint));
+
+        if (!t->frontCells || !t->frontColors || !t->frontHashes
+         || !t->backHashes || !t->rowLists || !(t->lists = glGenLists(rows)))
+        {
+            OGLCONSOLE_FreeFront(t);
+            return 0;
+        }
+
+        for (r = 0; r < rows; r++)
+        {
+            t->rowLists[r] = t->lists + r;
+            t->dirty[r] = 1;
+        }
+
+        t->listColumns = w;
+        t->listRows = rows;
+    }
+
+    for (r = 0; r < rows; r++)
+        t->backHashes[r] = t->dirty[r] ? OGLCONSOLE_RowHash(t->cells + r * w,
+                                                            t->colors + r * w,
+                                                            w)
+                                       : t->frontHashes[r];
+
+    /* Going down the rows which have changed, see whether each, and the rows
+     * after it, have moved up from k rows further down, or down from k rows
+     * further up, going by their hashes. Moving the display lists round
+     * (which puts k rows' out of place) is worth it for whichever k lets the
+     * most rows keep theirs; the rows are compared properly after */
+    for (r0 = 0; r0 < rows; r0 += best ? best + 2 * abs(shift) : 1)
+    {
+        best = 0;
+
+        if (!t->dirty[r0] || OGLCONSOLE_SameRow(t, r0, r0)) continue;
+
+        for (k = 1; r0 + k < rows; k++)
+        {
+            for (n = 0; r0 + n + k < rows
+                     && t->backHashes[r0 + n] == t->frontHashes[r0 + n + k];
+                 n++);
+            if (n - k > best)
+            {
+                best = n - k;
+                shift = k;
+            }
+
+            for (n = 0; r0 + n + k < rows
+                     && t->backHashes[r0 + n + k] == t->frontHashes[r0 + n];
+                 n++);
+            if (n - k > best)
+            {
+                best = n - k;
+                shift = -k;
+            }
+        }
+
+        if (best && !OGLCONSOLE_RotateFront(t, r0, r0 + best + 2 * abs(shift),
+                                            shift))
+            return 0;
+    }
+
+    /* Rebuild the rows which are still different */
+    for (r = 0; r < rows; r++)
+    {
+        const char *cells = t->cells + r * w;
+        const unsigned int *colors = t->colors + r * w;
+        int i, j;
+
+        if (!t->dirty[r] || OGLCONSOLE_SameRow(t, r, r))
+        {
+            t->dirty[r] = 0;
+            continue;
+        }
+
+        if (!(batch = OGLCONSOLE_PlanBatch(console, t->rowLists[r])))
+            return 0;
+        t->dirty[r] = 0;
+
+        for (i = 0; i < w; i = j)
+        {
+            for (j = i + 1; j < w && colors[j] == colors[i]; j++);
+
+            OGLCONSOLE_BatchText(batch, cells + i, j - i,
+                                 i * console->characterWidth, 0, colors[i]);
+        }
+
+        memcpy(t->frontCells + r * w, cells, w);
+        memcpy(t->frontColors + r * w, colors, w * sizeof(unsigned int));
+        t->frontHashes[r] = t->backHashes[r];
+    }
+
+    return 1;
+}
+
+/* Plan a terminal's screen, in the rows of the display which scrollback would
+ * take up, from its rows' display lists, and its cursor */
+static void OGLCONSOLE_PlanTerminal(_OGLCONSOLE_Console *console,
+                                    OGLCONSOLE_Batch *screen)
+{
+    OGLCONSOLE_Terminal *t = console->terminal;
+    int rows = console->textHeight - console->pinnedCount,
+        below = console->pinnedTop ? 0 : console->pinnedCount, row;
+    double w = console->characterWidth, h = console->characterHeight;
+
+    if (!OGLCONSOLE_UpdateFront(console)) return;
+
+    for (row = 0; row < min(rows, t->rows); row++)
+        OGLCONSOLE_PlanStep(console, STEP_CALL, t->rowLists[row],
+                            (rows - row + below) * h);
+
+    if (t->cursorShown && t->y < rows)
+        OGLCONSOLE_BatchText(screen, "_", 1, t->x * w,
+                             (rows - t->y + below) * h, 0xffff80);
+}
+
+/* Plan a console's pinned rows, rebuilding the display lists of those which
+ * have changed */
+static void OGLCONSOLE_PlanPinned(_OGLCONSOLE_Console *console)
+{
+    OGLCONSOLE_Batch *batch;
+    OGLCONSOLE_Pin *pin;
+    int i, row;
+
+    if (!console->pinnedCount) return;
+
+    OGLCONSOLE_SampleWatches(console);
+
+    if (!console->pinnedLists
+     && !(console->pinnedLists = glGenLists(MAX_PINNED_ROWS)))
+        return;
+
+    for (i = 0; i < console->pinnedCount; i++)
+    {
+        pin = console->pinned + i;
+
+        if (pin->dirty
+         && (batch = OGLCONSOLE_PlanBatch(console, console->pinnedLists + i)))
+        {
+            OGLCONSOLE_BatchText(batch, pin->text,
+                                 min(pin->length, console->textWidth), 0, 0,
+                                 0xffff00);
+            pin->dirty = 0;
+        }
+
+        /* The first pinned row is the top one */
+        row = console->pinnedTop ? console->textHeight - i
+                                 : console->pinnedCount - i;
+
+        OGLCONSOLE_PlanStep(console, STEP_CALL, console->pinnedLists + i,
+                            row * console->characterHeight);
+    }
+}
+
+/* Work out what a console will draw this frame, putting the text it has to
+ * make quads for into batches. Returns 0 if the console isn't drawn */
+static int OGLCONSOLE_Plan(_OGLCONSOLE_Console *console)
+{
+    OGLCONSOLE_Batch *screen;
+
+    /* Pick up blocks of scrollback which have been compressed meanwhile, and
+     * a view which has finished scanning */
+    OGLCONSOLE_LockStorage();
+    OGLCONSOLE_CollectPacked();
+    OGLCONSOLE_UnlockStorage();
+    OGLCONSOLE_CollectView(console);
+
+    /* And output queued by other threads, or held back for the budget */
+    OGLCONSOLE_FlushCapture(console);
+    OGLCONSOLE_DrainSome(console);
+
+    /* Try again with input a child program hasn't taken yet */
+    OGLCONSOLE_FlushChild(console);
+
+    /* Don't render hidden console */
+    if (console->visible == 0 && console->transitionComplete == 0) return 0;
+
+#ifdef OGLCONSOLE_SLIDE
+    /* Nor one which has finished sliding away */
+    if (console->transitionComplete
+     && SDL_GetTicks() >= console->transitionComplete)
+    {
+        console->transitionComplete = 0;
+        if (!console->visible) return 0;
+    }
+#endif
+
+    OGLCONSOLE_CatchUpIndex(console, INDEX_LINES_PER_FRAME);
+
+    /* A terminal's screen is kept the size of the display; ingesting nothing
+     * resizes it, with what scrolls off going into the scrollback */
+    if (console->terminal)
+        OGLCONSOLE_Ingest(console, "", 0);
+
+    OGLCONSOLE_InitGlyphs();
+
+    /* The first step draws the text which isn't in display lists */
+    console->batchCount = console->stepCount = 0;
+    if (!(screen = OGLCONSOLE_PlanBatch(console, 0))) return 0;
+
+    /* Make sure the line we're scrolled to is still in the scrollback, and
+     * smooth scrolling has moved on */
+    OGLCONSOLE_ScrollBy(console, 0);
+    OGLCONSOLE_Glide(console);
+
+    /* A terminal's screen goes where the end of the scrollback would, unless
+     * the scrollback is scrolled back */
+    if (console->terminal && console->rowScrollIndex == 0
+     && console->scrollFraction == 0
+     && console->lineScrollIndex == OGLCONSOLE_LastShown(console))
+        OGLCONSOLE_PlanTerminal(console, screen);
+    else
+        OGLCONSOLE_PlanScrollback(console, screen);
+
+    /* Here we draw the current commandline, it will either be a line from
+     * the command history (red) or the line being edited atm (cyan) with a
+     * beige cursor */
+    if (console->historyScrollIndex >= 0)
+    {
+        char *s = console->history[console->historyScrollIndex];
+
+        OGLCONSOLE_BatchText(screen, s, strlen(s), 0, 0, 0xff0000);
+    }
+    else
+    {
+        OGLCONSOLE_BatchText(screen, console->inputLine,
+                             strlen(console->inputLine), 0, 0, 0x00ffff);
+        OGLCONSOLE_BatchText(screen, "_", 1,
+                             console->inputCursorPos
+                           * console->characterWidth, 0, 0xffff80);
+    }
+
+    /* While output is waiting to go into the scrollback, say how much, in
+     * yellow at the right of the command line */
+    if (console->backlogLength > console->backlogStart)
+    {
+        char behind[32];
+        int n = sprintf(behind, "[%dK behind]",
+                (console->backlogLength - console->backlogStart + 1023)
+                / 1024);
+
+        OGLCONSOLE_BatchText(screen, behind, n,
+                (console->textWidth - n) * console->characterWidth, 0,
+                0xffff00);
+    }
+
+    OGLCONSOLE_PlanPinned(console);
+    return 1;
+}
+
+/* Planning a display list's compile marks what it's to hold as being there
+ * already: a scrollback line's slot gets the line's tag, a pinned row isn't
+ * dirty any more, and a terminal's front holds its rows. When a plan is
+ * dropped without being drawn, those lists never got compiled, so they're
+ * marked stale again, the terminal's all of them */
+static void OGLCONSOLE_DropPlan(_OGLCONSOLE_Console *console)
+{
+    OGLCONSOLE_Terminal *t = console->terminal;
+    GLuint list;
+    int i;
+
+    for (i = 0; i < console->stepCount; i++)
+    {
+        if (console->steps[i].type != STEP_COMPILE) continue;
+        list = console->steps[i].list;
+
+        if (console->lineLists && list >= console->lineLists
+         && list < console->lineLists + console->lineListCount)
+            console->lineTags[list - console->lineLists].line = -1;
+        else if (console->pinnedLists && list >= console->pinnedLists
+              && list < console->pinnedLists + MAX_PINNED_ROWS)
+            console->pinned[list - console->pinnedLists].dirty = 1;
+        else if (t && t->lists && list >= t->lists
+              && list < t->lists + t->listRows)
+            t->listColumns = 0;
+    }
+
+    console->batchCount = console->stepCount = 0;
+}
+
+/* This function draws a single specific console; if you only use one console in
+ * your program, use Draw() instead */
+void OGLCONSOLE_Render(OGLCONSOLE_Console console)
+{
+    OGLCONSOLE_Step *step;
+    float *quads;
+    double at = 0;
+    int i, prepared = C->plannedFrame == OGLCONSOLE_frame;
+
+    /* Plan the frame, unless Prepare() already has this frame; the plan is
+     * used up either way */
+    if (C->plannedFrame && !prepared)
+        OGLCONSOLE_DropPlan(C);
+    C->plannedFrame = 0;
+    if (!prepared && !OGLCONSOLE_Plan(C)) return;
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadMatrixd(C->pMatrix);
+ 
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadMatrixd(C->mvMatrix);
+
+    glPushAttrib(GL_ALL_ATTRIB_BITS);
+
+/*    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);*/
+
+    /* TODO: This SHOULD become an option at some point because the
+     * infrastructure for "real" consoles in the game (like you could walk up to
+     * a computer terminal and manipulate a console on a computer using
+     * oglconsole) already exists; you'd want depth testing in that case */
+    glDisable(GL_DEPTH_TEST);
+
+    /* With SDL, we have SDL_GetTicks(), so we can do a slide transition */
+#ifdef OGLCONSOLE_SLIDE
+    if (C->transitionComplete) {
+      unsigned int t = SDL_GetTicks();
+      double d = t < C->transitionComplete
+               ? (C->transitionComplete - t) / (double)SLIDE_MS : 0;
+      if (!C->visible)
+        d = 1 - d;
+      glTranslated(0, d, 0);
+    }
+#endif
+
+#if 0
+    /* Render hiding / showing console in a special manner. Zero means hidden. 1
+     * means visible. All other values are traveling toward zero or one. TODO:
+     * Make this time dependent */
+    if (C->visibility != 1)
+    {
+        double d; /* bra size */
+        int v = C->visibility;
+
+        /* Count down in both directions */
+        if (v < 0)
+        {
+            v ^= -1;
+            C->visibility++;
+        }
+        else
+        {
+            v = SLIDE_STEPS - v;
+            C->visibility--;
+        }
+
+        d = 0.04 * v;
+        glTranslated(0, 1-d, 0);
+    }
+#endif
+
+    /* First we draw our console's background TODO: Add something fancy? */
+    glDisable(GL_TEXTURE_2D);
+    glEnable(GL_BLEND);
+
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+//    glBlendFunc(GL_ONE_MINUS_DST_COLOR, GL_ONE_MINUS_SRC_COLOR);
+    glColor4d(.1,0,0, 0.5);
+
+    glBegin(GL_QUADS);
+    glVertex3d(0,0,0);
+    glVertex3d(1,0,0);
+    glVertex3d(1,1,0);
+    glVertex3d(0,1,0);
+    glEnd();
+
+    // Change blend mode for drawing text
+    glBlendFunc(GL_ONE, GL_ONE);
+
+    /* Select the console font */
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, OGLCONSOLE_glFontHandle);
+
+    /* Text is drawn from vertex arrays of texture coordinates and positions,
+     * and nothing else the program might have left turned on */
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_INDEX_ARRAY);
+    glDisableClientState(GL_EDGE_FLAG_ARRAY);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+    /* Send what was planned. Display lists are called one after another a
+     * little further up, so rather than each being translated from the
+     * origin and back, the translation moves on from the last one's, and only
+     * goes back to the origin for what's drawn from there */
+    for (i = 0, step = C->steps; i < C->stepCount; i++, step++)
+    {
+        if (step->type != STEP_CALL && at != 0)
+        {
+            glTranslated(0, -at, 0);
+            at = 0;
+        }
+
+        switch (step->type)
+        {
+            case STEP_DRAW:
+            case STEP_COMPILE:
+                /* Text Prepare() didn't build is built now, into the
+                 * array the last batch's was in */
+                quads = step->batch->built ? step->batch->quads
+                      : OGLCONSOLE_MakeQuads(step->batch,
+                                             &OGLCONSOLE_drawQuads,
+                                             &OGLCONSOLE_drawQuadSize);
+
+                if (step->type == STEP_COMPILE)
+                {
+                    glNewList(step->list, GL_COMPILE);
+                    OGLCONSOLE_DrawBatch(step->batch, quads);
+                    glEndList();
+                }
+                else
+                    OGLCONSOLE_DrawBatch(step->batch, quads);
+                break;
+
+            case STEP_CLIP:
+                if (step->height)
+                {
+                    GLdouble bottom[] = { 0, 1, 0, -step->y },
+                             top[] = { 0, -1, 0, step->y + step->height };
+
+                    glClipPlane(GL_CLIP_PLANE0, bottom);
+                    glClipPlane(GL_CLIP_PLANE1, top);
+                    glEnable(GL_CLIP_PLANE0);
+                    glEnable(GL_CLIP_PLANE1);
+                }
+                else
+                {
+                    glDisable(GL_CLIP_PLANE0);
+                    glDisable(GL_CLIP_PLANE1);
+                }
+                break;
+
+            default:
+                glTranslated(0, step->y - at, 0);
+                at = step->y;
+                glCallList(step->list);
+                break;
+        }
+    }
+
+    /* Relinquish our rendering settings */
+    glPopClientAttrib();
+
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+
+    glPopAttrib();
+}
+
+/* Get every console which is going to be drawn this frame ready to draw, with
+ * the quads for all their text built at once, on as many threads as there
+ * are CPUs (up to MAX_BUILD_THREADS). Render() then only has to send them to
+ * the GL. Call it each frame before rendering, if there are many consoles.
+ * Without build threads to share the work, or without enough text to be worth
+ * it, there's nothing to be gained by doing any of it ahead, so Render() is
+ * left to build each batch as it draws it */
+void OGLCONSOLE_Prepare()
+{
+    _OGLCONSOLE_Console *console;
+    long glyphs = 0;
+    int i;
+
+    OGLCONSOLE_buildCount = 0;
+
+    /* A new frame, so plans from frames whose consoles weren't rendered are
+     * stale; 0 is never a frame */
+    if (!++OGLCONSOLE_frame)
+        OGLCONSOLE_frame = 1;
+
+    for (console = OGLCONSOLE_consoles; console; console = (void*)console->next)
+    {
+        /* A plan from an earlier frame which wasn't rendered is dropped */
+        if (console->plannedFrame)
+            OGLCONSOLE_DropPlan(console);
+        console->plannedFrame = 0;
+    }
+
+    if (!OGLCONSOLE_Builders()) return;
+
+    for (console = OGLCONSOLE_consoles; console; console = (void*)console->next)
+    {
+        if (!OGLCONSOLE_Plan(console)) continue;
+        console->plannedFrame = OGLCONSOLE_frame;
+
+        /* Batches which can't be queued are built by Render() */
+        if (!OGLCONSOLE_Reserve(&OGLCONSOLE_buildQueue, &OGLCONSOLE_buildSize,
+                                OGLCONSOLE_buildCount + console->batchCount,
+                                sizeof(OGLCONSOLE_Batch*)))
+            continue;
+
+        for (i = 0; i < console->batchCount; i++)
+        {
+            OGLCONSOLE_buildQueue[OGLCONSOLE_buildCount++] =
+                console->batches[i];
+            glyphs += console->batches[i]->length;
+        }
+    }
+
+    if (glyphs >= BUILD_MIN_GLYPHS)
+        OGLCONSOLE_BuildAll();
+}
+
+/* How many threads Prepare() builds text on, counting the one it's called on;
+ * 0 is one per CPU. The threads are started again the next time they're
+ * needed */
+void OGLCONSOLE_SetBuildThreads(int threads)
+{
+#ifdef OGLCONSOLE_THREADS
+    OGLCONSOLE_StopBuilding();
+    OGLCONSOLE_buildThreads = max(threads, 0);
+#endif
+}
+
+/* This is the final, internal function for printing text to a console;
+ * channel is -1 for untagged output */
+static void OGLCONSOLE_VOutput(_OGLCONSOLE_Console *console, int channel,
+                               int severity, const char *s, va_list argument)
+{
+    /* String buffer */
+    char output[4096];
+    int length;
+
+    /* Format the output */
+    length = vsnprintf(output, 4096, s, argument);
+
+    /* With a budget, it waits its turn behind whatever was queued, and is put
+     * in the scrollback when the console is drawn */
+    if (C->drainBudget)
+    {
+        OGLCONSOLE_TakeQueue(C);
+        OGLCONSOLE_Backlog(C, output, strlen(output), channel, severity);
+        return;
+    }
+
+    /* Whatever was queued came first */
+    OGLCONSOLE_DrainQueue(C);
+
+    /* Pass it along to the console's sinks */
+    OGLCONSOLE_SinkOutput(C, output, min(length, 4095));
+
+    C->outputChannel = channel;
+    C->outputSeverity = severity;
+    OGLCONSOLE_Ingest(C, output, strlen(output));
+    C->outputChannel = -1;
+    C->outputSeverity = OGLCONSOLE_INFO;
+
+#ifdef DEBUG
+    printf("Copied \"%s\" into line %li\n", output, C->lineQueueIndex);
+#endif
+}
+
+/* Multi-Console Users: print text to a specific console; mono-console users use
+ * Print() */
+void OGLCONSOLE_Output(OGLCONSOLE_Console console, const char *s, ...)
+{
+    va_list argument;
+
+    va_start(argument, s);
+    OGLCONSOLE_VOutput(C, -1, OGLCONSOLE_INFO, s, argument);
+    va_end(argument);
+}
+
+/* Print output tagged with a channel and severity, if the console wants it */
+void OGLCONSOLE_OutputTagged(OGLCONSOLE_Console console, int channel,
+                             int severity, const char *s, ...)
+{
+    va_list argument;
+
+    if (!OGLCONSOLE_WANTS(console, channel, severity))
+        return;
+
+    va_start(argument, s);
+    OGLCONSOLE_VOutput(C, channel, severity, s, argument);
+    va_end(argument);
+}
+
+/* Set the least severe output a channel wants to see */
+void OGLCONSOLE_SetFilter(int channel, int minSeverity)
+{
+    unsigned long bits;
+    int i;
+
+    if (channel == -1)
+        bits = ~0ul;
+    else if (channel >= 0 && channel < OGLCONSOLE_CHANNELS)
+        bits = 1ul << channel;
+    else
+        return;
+
+    for (i = 0; i < OGLCONSOLE_SEVERITIES; i++)
+    {
+        if (i >= minSeverity)
+            programConsole->filter.mask[i] |= bits;
+        else
+            programConsole->filter.mask[i] &= ~bits;
+    }
+}
+
+/* Mono-Console Users: print text to the console; multi-console users use
+ * Output() */
+void OGLCONSOLE_Print(const char *s, ...)
+{
+    va_list argument;
+
+    va_start(argument, s);
+    OGLCONSOLE_VOutput(userConsole, -1, OGLCONSOLE_INFO, s, argument);
+    va_end(argument);
+}
+
+/* Replace the line being output to with some new output, for progress bars
+ * and such which redraw themselves. Once a line has been ended with a
+ * newline, the next line is the one replaced */
+void OGLCONSOLE_RewriteLine(OGLCONSOLE_Console console, const char *s, ...)
+{
+    va_list argument;
+    char output[4096];
+    int length;
+
+    va_start(argument, s);
+    length = vsnprintf(output, 4096, s, argument);
+    va_end(argument);
+
+    /* The line being output to is the one the backlog ends on, so all of it
+     * goes into the scrollback first, budget or not */
+    OGLCONSOLE_DrainQueue(C);
+
+    /* Sinks see it the way a terminal would show it */
+    OGLCONSOLE_SinkOutput(C, "\r", 1);
+    OGLCONSOLE_SinkOutput(C, output, min(length, 4095));
+
+    if (!C->outputNewline)
+    {
+        OGLCONSOLE_LockStorage();
+        OGLCONSOLE_Truncate(C);
+        OGLCONSOLE_UnlockStorage();
+    }
+
+    OGLCONSOLE_Ingest(C, output, strlen(output));
+}
+
+/* Give a console a line of broadcast output, text in the shared block. It's a
+ * line of its own, so whatever the console was in the middle of is ended
+ * first, and the next output starts after it. Scrollback in a file can't
+ * refer to the shared block, so the text is copied there */
+static void OGLCONSOLE_ShareLine(_OGLCONSOLE_Console *console,
+                                 OGLCONSOLE_Block *block, int offset,
+                                 int length)
+{
+    OGLCONSOLE_Line *l;
+    int follow, unfinished = !console->outputNewline
+                  && OGLCONSOLE_LineLength(console, console->lineQueueIndex);
+
+    if (console->file)
+    {
+        OGLCONSOLE_Ingest(console, "\n", unfinished);
+        OGLCONSOLE_Ingest(console, block->text + offset, length);
+        OGLCONSOLE_Ingest(console, "\n", 1);
+        return;
+    }
+
+    OGLCONSOLE_CollectView(C);
+    follow = C->lineScrollIndex == OGLCONSOLE_LastShown(C)
+          && C->rowScrollIndex == 0 && C->scrollFraction == 0;
+
+    OGLCONSOLE_LockStorage();
+
+    if (unfinished)
+    {
+        OGLCONSOLE_EndLine(console);
+        console->outputNewline = 1;
+    }
+
+    if (console->outputNewline)
+    {
+        console->outputNewline = 0;
+        OGLCONSOLE_NewLine(console);
+    }
+
+    if ((l = OGLCONSOLE_GetLine(console, console->lineQueueIndex)))
+    {
+        OGLCONSOLE_ReleaseBlock(l->block);
+        l->block = block;
+        l->offset = offset;
+        l->length = length;
+        block->refs++;
+
+        OGLCONSOLE_IndexOutput(console, block->text + offset, 0, length);
+        OGLCONSOLE_CommitLine(console);
+    }
+
+    /* Nothing may be appended to this line, since it isn't in the console's
+     * own block */
+    console->outputNewline = 1;
+
+    OGLCONSOLE_UnlockStorage();
+
+    if (follow)
+        C->lineScrollIndex = OGLCONSOLE_LastShown(C);
+}
+
+/* Put a line of broadcast output into the shared block, and give it to every
+ * console in any of the groups */
+static void OGLCONSOLE_BroadcastLine(unsigned long groups, const char *text,
+                                     int length)
+{
+    OGLCONSOLE_Block *block = OGLCONSOLE_sharedBlock;
+    _OGLCONSOLE_Console *console;
+    int offset;
+
+    if (!block || block->used + length > OGLCONSOLE_PAGE_SIZE)
+    {
+        if (!(block = OGLCONSOLE_NewBlock())) return;
+
+        OGLCONSOLE_LockStorage();
+        OGLCONSOLE_SealBlock(OGLCONSOLE_sharedBlock);
+        OGLCONSOLE_ReleaseBlock(OGLCONSOLE_sharedBlock);
+        OGLCONSOLE_sharedBlock = block;
+        OGLCONSOLE_UnlockStorage();
+    }
+
+    offset = block->used;
+    memcpy(block->text + offset, text, length);
+    block->used += length;
+
+    for (console = OGLCONSOLE_consoles; console; console = (void*)C->next)
+        if (console->groups & groups)
+            OGLCONSOLE_ShareLine(console, block, offset, length);
+}
+
+/* Output to every console in any of some broadcast groups (bit N of groups
+ * for group N). It's formatted once, and its lines are kept once and shared
+ * by all of the consoles. Each line of it is a line of its own in them */
+void OGLCONSOLE_Broadcast(unsigned long groups, const char *s, ...)
+{
+    _OGLCONSOLE_Console *console;
+    va_list argument;
+    char output[4096], line[MAX_LINE_LENGTH];
+    int length, column = 0, end = 0, i, stop;
+
+    va_start(argument, s);
+    length = vsnprintf(output, 4096, s, argument);
+    va_end(argument);
+
+    length = max(0, min(length, 4095));
+
+    OGLCONSOLE_LockStorage();
+    OGLCONSOLE_CollectPacked();
+    OGLCONSOLE_UnlockStorage();
+
+    /* Its lines go straight into the scrollback, so whatever the consoles
+     * have waiting in their backlogs goes in ahead of them, budget or not */
+    for (console = OGLCONSOLE_consoles; console; console = (void*)C->next)
+        if (C->groups & groups)
+        {
+            OGLCONSOLE_DrainQueue(C);
+            OGLCONSOLE_SinkOutput(C, output, length);
+        }
+
+    /* Lines are laid out the way output would lay them out */
+    for (i = 0; i < length; i++)
+    {
+        switch (output[i])
+        {
+            case '\n':
+                OGLCONSOLE_BroadcastLine(groups, line, end);
+                column = end = 0;
+                break;
+
+            case '\r':
+                column = 0;
+                break;
+
+            case '\t':
+                stop = column + TAB_WIDTH - column % TAB_WIDTH;
+                for (column = min(stop, end); column < stop; )
+                    line[column++] = ' ';
+                end = max(end, column);
+                break;
+
+            case '\0':
+                break;
+
+            default:
+                line[column++] = output[i];
+                end = max(end, column);
+                break;
+        }
+
+        if (end >= MAX_LINE_LENGTH - TAB_WIDTH)
+        {
+            OGLCONSOLE_BroadcastLine(groups, line, end);
+            column = end = 0;
+        }
+    }
+
+    if (end)
+        OGLCONSOLE_BroadcastLine(groups, line, end);
+}
+
+/* Sets which broadcast groups the console being edited belongs to, bit N for
+ * group N; 0 (the default) is none */
+void OGLCONSOLE_SetGroups(unsigned long groups)
+{
+    programConsole->groups = groups;
+}
+
+/* Output to a console from any thread. The output shows up the next time the
+ * console is drawn or output to from the main thread */
+void OGLCONSOLE_QueueOutput(OGLCONSOLE_Console console, const char *s, ...)
+{
+    va_list argument;
+    char output[4096];
+    int length;
+
+    va_start(argument, s);
+    length = vsnprintf(output, 4096, s, argument);
+    va_end(argument);
+
+    OGLCONSOLE_Enqueue(C, output, min(length, 4095));
+}
+
+#if 0
+/* Multi-Console Users: print text to a specific console; mono-console users use
+ * Print() */
+void OGLCONSOLE_Output(OGLCONSOLE_Console console, char *s)
+{
+    /* TODO: Chop up output to wrap text */
+
+    /* TODO: Add auto-scroll (the commented out code here is a failed attempt,
+     * my brain is too scattered to do it) */
+    /* If the console isn't scrolled up, then we move the scroll point */
+/*    if (C->lineQueueIndex - C->lineScrollIndex == C->textHeight)
+        if (++C->lineScrollIndex - C->lineScrollIndex >= MAX_LINE_COUNT)
+            C->lineScrollIndex = 0;*/
+
+}
+#endif
+
+/* Set the dimensions of the console in columns and lines of characters. Only
+ * the lines that end up on the screen are rewrapped to the new width */
+void OGLCONSOLE_SetDimensions(int width, int height)
+{
+    int i;
+
+    if (width < 1) width = 1;
+    if (height < 1) height = 1;
+
+    programConsole->textWidth = width;
+    programConsole->textHeight = height;
+    programConsole->characterWidth = 1.0 / width;
+    programConsole->characterHeight = 1.0 / height;
+    programConsole->listGeneration++;
+
+    /* Pinned rows have to be drawn to the new size */
+    for (i = 0; i < MAX_PINNED_ROWS; i++)
+        programConsole->pinned[i].dirty = 1;
+    programConsole->pinnedCount = min(programConsole->pinnedCount, height - 1);
 
-/* Internal functions for drawing text. You don't want these, do you? */
-static void OGLCONSOLE_DrawString(char *s, double x, double y,
-                                           double w, double h, double z);
-static void OGLCONSOLE_DrawWrapString(char *s, double x, double y,
-                                               double w, double h,
-                                               double z, int wrap);
-static void OGLCONSOLE_DrawCharacter(unsigned char c, double x, double y,
-                                            double w, double h,
-                                            double z);
+    /* Don't leave the view part way through a line that has fewer rows now */
+    OGLCONSOLE_ScrollBy(programConsole, 0);
+}
 
-/* This function draws a single specific console; if you only use one console in
- * your program, use Draw() instead */
-void OGLCONSOLE_Render(OGLCONSOLE_Console console)
+/* Set how many lines of output the console remembers. Memory is only spent on
+ * lines which actually get printed, so this can be very large */
+void OGLCONSOLE_SetScrollback(int lines)
 {
-    /* Don't render hidden console */
-    if (C->visible == 0 && C->transitionComplete == 0) return;
+    if (lines < 1) lines = 1;
 
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glLoadMatrixd(C->pMatrix);
- 
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
-    glLoadMatrixd(C->mvMatrix);
+    OGLCONSOLE_LockStorage();
+    OGLCONSOLE_ResizeScrollback(programConsole, lines);
+    OGLCONSOLE_UnlockStorage();
 
-    glPushAttrib(GL_ALL_ATTRIB_BITS);
+    /* Don't leave the view scrolled past the end of the scrollback */
+    OGLCONSOLE_ScrollBy(programConsole, 0);
+}
 
-/*    glEnable(GL_BLEND);
-    glBlendFunc(GL_ONE, GL_ONE);*/
+/* Keep the console's scrollback in a file (and an index of it at path.idx)
+ * instead of in memory, so that it survives the program. If the file already
+ * exists, the output in it is picked up where it left off. Returns 0 if the
+ * file can't be used, in which case the scrollback stays where it is */
+int OGLCONSOLE_SetScrollbackFile(const char *path)
+{
+#ifdef OGLCONSOLE_POSIX
+    _OGLCONSOLE_Console *console = programConsole;
+    OGLCONSOLE_File *file = OGLCONSOLE_OpenFile(path);
+    char *pattern = NULL;
+    int p;
+
+    if (!file) return 0;
+
+    /* Views of the old output go too, but their expression carries over */
+    if (console->pendingView || console->view)
+        pattern = strdup((console->pendingView ? console->pendingView
+                                               : console->view)->pattern);
+    OGLCONSOLE_FreeView(console->pendingView);
+    OGLCONSOLE_FreeView(console->view);
+    console->pendingView = console->view = NULL;
+
+    OGLCONSOLE_LockStorage();
+
+    /* Whatever output we had in memory or in another file goes away */
+    for (p = 0; p < console->pageCount; p++)
+    {
+        OGLCONSOLE_FreeLines(console->pages[p]);
+        console->pages[p] = NULL;
+    }
+    OGLCONSOLE_CloseFile(console->file);
 
-    /* TODO: This SHOULD become an option at some point because the
-     * infrastructure for "real" consoles in the game (like you could walk up to
-     * a computer terminal and manipulate a console on a computer using
-     * oglconsole) already exists; you'd want depth testing in that case */
-    glDisable(GL_DEPTH_TEST);
+    console->file = file;
+    console->lineQueueIndex = file->index->lines - 1;
+    console->listGeneration++;
+    console->unindexed = -1;
+    OGLCONSOLE_ScrollTo(console, console->lineQueueIndex);
 
-    /* With SDL, we have SDL_GetTicks(), so we can do a slide transition */
-#ifdef OGLCONSOLE_SLIDE
-    if (C->transitionComplete) {
-      unsigned int t = SDL_GetTicks();
-      if (t < C->transitionComplete) {
-        double d = (C->transitionComplete - t) / (double)SLIDE_MS;
-        if (!C->visible)
-          d = 1 - d;
-        glTranslated(0, d, 0);
-      } else {
-        C->transitionComplete = 0;
-        if (!C->visible)
-          return;
-      }
-    }
-#endif
+    /* New output doesn't get tacked onto the end of old output */
+    console->outputNewline =
+        OGLCONSOLE_LineLength(console, console->lineQueueIndex) > 0;
+    console->outputColumn = 0;
 
-#if 0
-    /* Render hiding / showing console in a special manner. Zero means hidden. 1
-     * means visible. All other values are traveling toward zero or one. TODO:
-     * Make this time dependent */
-    if (C->visibility != 1)
-    {
-        double d; /* bra size */
-        int v = C->visibility;
+    OGLCONSOLE_UnlockStorage();
 
-        /* Count down in both directions */
-        if (v < 0)
-        {
-            v ^= -1;
-            C->visibility++;
-        }
-        else
-        {
-            v = SLIDE_STEPS - v;
-            C->visibility--;
-        }
+    if (pattern)
+        console->pendingView = OGLCONSOLE_StartView(console, pattern);
+    free(pattern);
 
-        d = 0.04 * v;
-        glTranslated(0, 1-d, 0);
-    }
+    return 1;
+#else
+    return 0;
 #endif
+}
 
-    /* First we draw our console's background TODO: Add something fancy? */
-    glDisable(GL_TEXTURE_2D);
-    glEnable(GL_BLEND);
+/* Count lines which repeat one of the last few lines of output, instead of
+ * outputting them again; lines is how far back to look, up to
+ * COALESCE_WINDOW, and 0 turns it off */
+void OGLCONSOLE_SetCoalesce(int lines)
+{
+    programConsole->coalesce = max(0, min(lines, COALESCE_WINDOW));
+}
 
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-//    glBlendFunc(GL_ONE_MINUS_DST_COLOR, GL_ONE_MINUS_SRC_COLOR);
-    glColor4d(.1,0,0, 0.5);
+/* Spend at most this many microseconds a frame putting output into the
+ * scrollback; 0 (the default) puts it all in right away. Output waiting its
+ * turn is put in when the console is drawn, even while it's hidden */
+void OGLCONSOLE_SetDrainBudget(unsigned int microseconds)
+{
+    programConsole->drainBudget = microseconds;
+}
 
-    glBegin(GL_QUADS);
-    glVertex3d(0,0,0);
-    glVertex3d(1,0,0);
-    glVertex3d(1,1,0);
-    glVertex3d(0,1,0);
-    glEnd();
+/* How many bytes of output are waiting to go into the scrollback */
+int OGLCONSOLE_GetBacklog()
+{
+    return programConsole->backlogLength - programConsole->backlogStart;
+}
 
-    // Change blend mode for drawing text
-    glBlendFunc(GL_ONE, GL_ONE);
+/* Start showing only the lines which match an expression (or NULL for any)
+ * and pass the console's filter on metadata, or all of them if neither
+ * leaves anything out */
+static int OGLCONSOLE_Reshow(_OGLCONSOLE_Console *console,
+                             const char *pattern)
+{
+    OGLCONSOLE_View *view = NULL;
 
-    /* Select the console font */
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, OGLCONSOLE_glFontHandle);
+    if ((pattern || console->shownSeverity > OGLCONSOLE_TRACE
+                 || ~console->shownChannels)
+     && !(view = OGLCONSOLE_StartView(console, pattern)))
+        return 0;
 
-    /* Recolor text */
-    glColor3d(0,1,0);
+    OGLCONSOLE_FreeView(console->pendingView);
+    console->pendingView = view;
 
-    /* Render console contents */
-    glBegin(GL_QUADS);
+    /* Showing everything again doesn't have to wait for anything */
+    if (!view)
     {
-        /* Graphical line, and line in lines[] */
-        int gLine, tLine = C->lineScrollIndex;
-
-        /* Iterate through each line being displayed */
-        for (gLine = 0; gLine < C->textHeight; gLine++)
-        {
-            /* Draw this line of text adjusting for user scrolling up/down */
-            OGLCONSOLE_DrawString(C->lines + (tLine * C->textWidth),
-                    0,
-                    (C->textHeight - gLine) * C->characterHeight,
-                    C->characterWidth,
-                    C->characterHeight,
-                    0);
+        OGLCONSOLE_FreeView(console->view);
+        console->view = NULL;
+        OGLCONSOLE_ScrollTo(console, console->lineQueueIndex);
+    }
 
-            /* Grab next line of text using wheel-queue wrapping */
-            if (++tLine >= C->maxLines) tLine = 0;
-        }
+    return 1;
+}
 
-        /* Here we draw the current commandline, it will either be a line from
-         * the command history or the line being edited atm */
-        if (C->historyScrollIndex >= 0)
-        {
-            glColor3d(1,0,0);
-            OGLCONSOLE_DrawString(
-                    C->history[C->historyScrollIndex],
-                    0, 0,
-                    C->characterWidth,
-                    C->characterHeight,
-                    0);
-        }
-        else
-        {
-            /* Draw input line cyan */
-            glColor3d(0,1,1);
-            OGLCONSOLE_DrawString(C->inputLine,
-                    0, 0,
-                    C->characterWidth,
-                    C->characterHeight,
-                    0);
+/* Show only the lines of output which match a regular expression (POSIX
+ * extended), like grep; NULL or "" shows them all again. The lines already
+ * in the scrollback are gone through by background threads, and the display
+ * keeps showing what it was until they're done. Returns 0 if the expression
+ * doesn't compile */
+int OGLCONSOLE_SetGrep(const char *pattern)
+{
+    return OGLCONSOLE_Reshow(programConsole,
+                             pattern && *pattern ? pattern : NULL);
+}
 
-            /* Draw cursor beige */
-            glColor3d(1,1,.5);
-            OGLCONSOLE_DrawCharacter('_',
-                    C->inputCursorPos * C->characterWidth, 0,
-                    C->characterWidth,
-                    C->characterHeight,
-                    0);
-        }
-    }
-    glEnd();
+/* Show only the lines of output at least minSeverity, and of those which were
+ * tagged, only ones from the channels in channels (bit N for channel N);
+ * untagged lines count as OGLCONSOLE_INFO. OGLCONSOLE_TRACE and ~0ul show
+ * them all again. This goes along with SetGrep(), and only the lines'
+ * metadata is looked at for it. Returns 0 if there's no memory for it */
+int OGLCONSOLE_SetShownTags(int minSeverity, unsigned long channels)
+{
+    _OGLCONSOLE_Console *console = programConsole;
+    OGLCONSOLE_View *view = console->pendingView ? console->pendingView
+                                                 : console->view;
 
-    /* Relinquish our rendering settings */
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
+    console->shownSeverity = minSeverity;
+    console->shownChannels = channels;
 
-    glMatrixMode(GL_MODELVIEW);
-    glPopMatrix();
+    return OGLCONSOLE_Reshow(console, view ? view->pattern : NULL);
+}
 
-    glPopAttrib();
+/* Set the gutter for the console being edited: which of the lines' metadata
+ * to show to their left, OGLCONSOLE_GUTTER_ flags or 0 for none */
+void OGLCONSOLE_SetGutter(int flags)
+{
+    programConsole->gutter = flags;
+    programConsole->gutterWidth = (flags & OGLCONSOLE_GUTTER_TIME ? 13 : 0)
+                                + (flags & OGLCONSOLE_GUTTER_SEVERITY ? 2 : 0)
+                                + (flags & OGLCONSOLE_GUTTER_CHANNEL ? 3 : 0);
+    programConsole->listGeneration++;
 }
 
-/* Issue rendering commands for a single a string */
-static void OGLCONSOLE_DrawString(char *s, double x, double y,
-                                           double w, double h, double z)
+/* Set which color codes are taken out of output to the console being edited
+ * and used to color it, OGLCONSOLE_COLORS_ flags; with 0, they show as text */
+void OGLCONSOLE_SetColorCodes(int flags)
 {
-    while (*s)
-    {
-        OGLCONSOLE_DrawCharacter(*s, x, y, w, h, z);
-        s++;
-        x += w;
-    }
+    programConsole->colorCodes = flags;
 }
 
-/* Issue rendering commands for a single a string */
-static void OGLCONSOLE_DrawWrapString(char *s, double x, double y,
-                                               double w, double h,
-                                               double z, int wrap)
+/* Turn terminal mode on or off for the console being edited. Turning it off
+ * puts the screen, down to the cursor, into the scrollback. Returns 0 if
+ * there's no memory for it */
+int OGLCONSOLE_SetTerminal(int on)
 {
-    int pos = 0;
-    double X = x;
+    _OGLCONSOLE_Console *console = programConsole;
+    OGLCONSOLE_Terminal *t = console->terminal;
+    int row;
 
-    while (*s)
+    if (!on && t)
     {
-        OGLCONSOLE_DrawCharacter(*s, X, y, w, h, z);
-        s++;
-        X += w;
+        OGLCONSOLE_LockStorage();
+        for (row = 0; row <= t->y && !t->alternate; row++)
+            OGLCONSOLE_VTScrollOff(console, row);
+        OGLCONSOLE_UnlockStorage();
+
+        OGLCONSOLE_FreeTerminal(t);
+        console->terminal = NULL;
+        OGLCONSOLE_ScrollTo(console, OGLCONSOLE_LastShown(console));
+    }
 
-        if (++pos >= wrap)
-        {
-            pos = 0;
-            y += h;
-            X = x;
-        }
+    if (!on || t) return 1;
+
+    if (!(t = calloc(1, sizeof(OGLCONSOLE_Terminal)))) return 0;
+
+    OGLCONSOLE_InitVT();
+    t->cursorShown = t->autowrap = 1;
+    console->terminal = t;
+
+    /* Make the screen */
+    OGLCONSOLE_Ingest(console, "", 0);
+
+    if (!t->cells)
+    {
+        OGLCONSOLE_FreeTerminal(t);
+        console->terminal = NULL;
+        return 0;
     }
+
+    return 1;
 }
 
-/* Issue rendering commands for a single character */
-static void OGLCONSOLE_DrawCharacter(unsigned char c, double x, double y,
-                                            double w, double h, double z)
+/* Run a program in the console being edited, which goes into terminal mode
+ * for it. Until it exits, keys typed into the console go to it */
+int OGLCONSOLE_RunChild(const char *command)
 {
-//  static int message = 0;
-    double cx, cy, cX, cY;
+    int terminal = programConsole->terminal != NULL;
 
-    cx = (c % 16) * CHAR_WIDTH;
-    cX = cx + CHAR_WIDTH;
+    if (!OGLCONSOLE_SetTerminal(1)) return 0;
 
-    cY = (c / 16) * CHAR_HEIGHT;
-    cy = cY + CHAR_HEIGHT;
+    if (OGLCONSOLE_Spawn(programConsole, command)) return 1;
 
-/*  if (message != c)
-    {
-        printf("For %i we got %f, %f\n", c, x, y);
-        message = c;
-    }*/
+    /* Without a program to run, the console goes back to how it was */
+    if (!terminal)
+        OGLCONSOLE_SetTerminal(0);
+    return 0;
+}
 
-    /* This should occur outside of this function for optimiation TODO: MOVE IT */
-    glTexCoord2d(cx, cy); glVertex3d(x,   y,   z);
-    glTexCoord2d(cX, cy); glVertex3d(x+w, y,   z);
-    glTexCoord2d(cX, cY); glVertex3d(x+w, y+h, z);
-    glTexCoord2d(cx, cY); glVertex3d(x,   y+h, z);
+/* Stop the program running in the console being edited */
+void OGLCONSOLE_StopChild()
+{
+    OGLCONSOLE_EndChild(programConsole);
 }
 
-/* This is the final, internal function for printing text to a console */
-void OGLCONSOLE_Output(OGLCONSOLE_Console console, const char *s, ...)
+/* Pin some rows of text to the bottom of the console being edited, or to the
+ * top if top is set, leaving the rest for scrollback. 0 rows unpins them.
+ * Pinned rows are set with SetPinned() or Watch() and never scroll */
+void OGLCONSOLE_SetPinnedRows(int rows, int top)
 {
-    va_list argument;
+    _OGLCONSOLE_Console *console = programConsole;
+    int i;
 
-    /* cache some console properties */
-    int lineQueueIndex = C->lineQueueIndex;
-    int lineScrollIndex = C->lineScrollIndex;
-    int textWidth = C->textWidth;
-    int maxLines = C->maxLines;
+    console->pinnedCount = max(0, min(min(rows, MAX_PINNED_ROWS),
+                                      console->textHeight - 1));
+    console->pinnedTop = top;
 
-    /* String buffer */
-    char output[4096];
+    for (i = 0; i < MAX_PINNED_ROWS; i++)
+        console->pinned[i].dirty = 1;
+}
 
-    /* string copy cursors */
-    char *consoleCursor, *outputCursor = output;
+/* Set the text of a pinned row, counting from the top one. This stops it
+ * watching anything */
+void OGLCONSOLE_SetPinned(int slot, const char *s, ...)
+{
+    OGLCONSOLE_Pin *pin;
+    char text[PINNED_LENGTH];
+    va_list argument;
+    int n;
+
+    if (slot < 0 || slot >= MAX_PINNED_ROWS) return;
+    pin = programConsole->pinned + slot;
+    pin->variable = NULL;
 
-    /* Acrue arguments in argument list */
     va_start(argument, s);
-    vsnprintf(output, 4096, s, argument);
+    n = vsnprintf(text, PINNED_LENGTH, s, argument);
     va_end(argument);
 
+    /* Nothing to redraw if nothing changed */
+    if (!strcmp(text, pin->text)) return;
 
+    strcpy(pin->text, text);
+    pin->length = max(0, min(n, PINNED_LENGTH - 1));
+    pin->dirty = 1;
+}
 
-    /* This cursor tells us where in the console display we are currently
-     * copying text into from the "output" string */
-    consoleCursor = C->outputCursor;
-
-    while (*outputCursor)
-    {
-        /* Here we check to see if any conditions require console line
-         * advancement. These two conditions are:
-            1) Hitting the end of the screen
-            2) Getting a newline character (indicated by "outputNewline") */
-        if((C->outputNewline) ||
-            (consoleCursor - (C->lines + lineQueueIndex * textWidth))
-                >= (textWidth - 1))
-        {
-            C->outputNewline = 0;
+/* Keep a pinned row showing a variable of the given type, formatted with a
+ * printf format for it, looking at it every interval milliseconds. A NULL
+ * variable stops watching */
+void OGLCONSOLE_Watch(int slot, const char *format, int type,
+                      const void *variable, int interval)
+{
+    OGLCONSOLE_Pin *pin;
+
+    if (slot < 0 || slot >= MAX_PINNED_ROWS
+     || type < OGLCONSOLE_WATCH_INT || type > OGLCONSOLE_WATCH_DOUBLE)
+        return;
+    pin = programConsole->pinned + slot;
+
+    pin->variable = variable;
+    pin->type = type;
+    pin->interval = max(interval, 0);
+    pin->next = SDL_GetTicks();
+    pin->sampled = 0;
+    snprintf(pin->format, PINNED_LENGTH, "%s", format);
+}
 
-            //puts("incrementing to the next line");
+/* Capture the program's stdout and stderr, so that whatever anything prints to
+ * them is output to the console being edited. It's read by a background
+ * thread, so printing doesn't wait on the console. With passThrough, it still
+ * goes to the original stdout and stderr as well. Returns 0 on failure */
+int OGLCONSOLE_CaptureStdio(int passThrough)
+{
+    return OGLCONSOLE_Capture(programConsole, passThrough);
+}
 
-            /* Inrement text-line index, with wrapping */
-            if (++lineQueueIndex >= maxLines)
-                lineQueueIndex = 0;
+/* Put stdout and stderr back */
+void OGLCONSOLE_StopCapture()
+{
+    OGLCONSOLE_Uncapture();
+}
 
-            /* Scroll the console display one line TODO: Don't scroll if the console is
-             * currently scrolled away from the end of output? */
-            if (++lineScrollIndex >= maxLines)
-                lineScrollIndex = 0;
+/* How many bytes of captured output have been dropped because the console
+ * wasn't taking it fast enough */
+unsigned long OGLCONSOLE_GetCaptureDropped()
+{
+#if defined(OGLCONSOLE_POSIX) && defined(OGLCONSOLE_THREADS)
+    return __sync_fetch_and_add(&OGLCONSOLE_captureDropped, 0);
+#else
+    return 0;
+#endif
+}
 
-            /* Reposition the cursor at the beginning of the new line */
-            consoleCursor = C->lines + lineQueueIndex * C->textWidth;
-        }
-        
-        /* If we encounter a newline character, we set the newline flag, which
-         * tells the console to advance one line before it prints the next
-         * character. The reason we do it this way is to defer line-advancement,
-         * and thus we needn't suffer through a needless blank line between
-         * console output and the command line, wasting precious screen
-         * real-estate */
-        if (*outputCursor == '\n')
-        {
-            C->outputNewline = 1;
-            outputCursor++;
-            continue;
-        }
+/* Copy everything output to the console being edited to the end of a file as
+ * well. The writing is done by a separate thread */
+int OGLCONSOLE_AddFileSink(const char *path)
+{
+#ifdef OGLCONSOLE_POSIX
+    int fd = open(path, O_WRONLY|O_CREAT|O_APPEND, 0644);
 
-        /* If we encounter a tab character we must expand that character
-         * appropriately */
-        if (*outputCursor == '\t')
-        {
-            const int TAB_WIDTH = 8;
+    if (fd < 0) return 0;
 
-            int n = (consoleCursor - (C->lines + lineQueueIndex * textWidth)) % TAB_WIDTH;
+    if (!OGLCONSOLE_AddSink(programConsole, fd, NULL, NULL))
+    {
+        close(fd);
+        return 0;
+    }
 
-            /* Are we indenting our way off the edge of the screen? */
-            if (textWidth - n <= TAB_WIDTH)
-            {
-                /* Switch on the console's newline bit, and advance through the
-                 * string output we've been given */
-                C->outputNewline = 1;
-                outputCursor++;
-                continue;
-            }
+    return 1;
+#else
+    return 0;
+#endif
+}
 
-            /* Normal indent */
-            else
-            {
-                n = TAB_WIDTH - n % TAB_WIDTH;
-                while (n--) *(consoleCursor++) = ' ';
-                outputCursor++;
-                continue;
-            }
-        }
+/* Copy everything output to the console being edited to stdout as well. We
+ * hang on to what stdout is now, in case it gets redirected later */
+int OGLCONSOLE_AddStdoutSink()
+{
+#ifdef OGLCONSOLE_POSIX
+    int fd = dup(1);
 
-        /* copy a single character */
-        *(consoleCursor++) = *(outputCursor++);
+    /* While stdout is captured, the real one is elsewhere */
+#ifdef OGLCONSOLE_THREADS
+    if (OGLCONSOLE_capturedFds[0] >= 0)
+    {
+        close(fd);
+        fd = dup(OGLCONSOLE_capturedFds[0]);
     }
+#endif
 
-    /* Unless we're at the very end of our current line, we finish up by capping
-     * a NULL terminator on the current line */
-    if (consoleCursor != C->lines + (lineQueueIndex+1) *C->textWidth -1)
-        *consoleCursor = '\0';
+    if (fd < 0) return 0;
 
-    /* Restore cached values */
-    C->lineQueueIndex = lineQueueIndex;
-    C->lineScrollIndex = lineScrollIndex;
-    C->outputCursor = consoleCursor; // TODO: confusing variable names
+    if (!OGLCONSOLE_AddSink(programConsole, fd, NULL, NULL))
+    {
+        close(fd);
+        return 0;
+    }
 
-    /* old way of copying the text into the console */
-    //strcpy(C->lines[C->lineQueueIndex], output);
-#ifdef DEBUG
-    printf("Copied \"%s\" into line %i\n", output, C->lineQueueIndex);
+    return 1;
+#else
+    return 0;
 #endif
 }
 
-/* Mono-Console Users: print text to the console; multi-console users use
- * Output() */
-void OGLCONSOLE_Print(const char *s, ...)
+/* Pass everything output to the console being edited to a function of yours.
+ * It gets called from another thread, with the text as it was output */
+int OGLCONSOLE_AddCallbackSink(void(*cbfun)(OGLCONSOLE_Console console,
+                                            const char *text, int length,
+                                            void *data),
+                               void *data)
 {
-    va_list argument;
-    char output[4096];
+    return OGLCONSOLE_AddSink(programConsole, -1, cbfun, data);
+}
 
-    /* Acrue arguments in argument list */
-    va_start(argument, s);
-    vsnprintf(output, 4096, s, argument);
-    va_end(argument);
+/* When sinks fall behind, should output to them be dropped (the default), or
+ * should the console wait for them to catch up? */
+void OGLCONSOLE_SetSinkBlocking(int block)
+{
+    programConsole->sinkBlock = block;
+}
 
-    /* TODO: Find some way to pass the va_list arguments to OGLCONSOLE_Output
-     * so that we don't waste extra time with the "%s" bullshit */
-    OGLCONSOLE_Output((OGLCONSOLE_Console)userConsole, "%s", output);
+/* How many bytes of output have been dropped because sinks fell behind */
+unsigned long OGLCONSOLE_GetSinkDropped()
+{
+    return programConsole->sinkDropped;
 }
 
-#if 0
-/* Multi-Console Users: print text to a specific console; mono-console users use
- * Print() */
-void OGLCONSOLE_Output(OGLCONSOLE_Console console, char *s)
+/* Scrolls the console back (direction -1) or forward (direction 1) to the next
+ * line containing text, ignoring case, which is then shown at the bottom of
+ * the display. Returns 0, without scrolling, if there isn't one */
+int OGLCONSOLE_Find(OGLCONSOLE_Console console, const char *text,
+                    int direction)
 {
-    /* TODO: Chop up output to wrap text */
+    long line;
 
-    /* TODO: Add auto-scroll (the commented out code here is a failed attempt,
-     * my brain is too scattered to do it) */
-    /* If the console isn't scrolled up, then we move the scroll point */
-/*    if (C->lineQueueIndex - C->lineScrollIndex == C->textHeight)
-        if (++C->lineScrollIndex - C->lineScrollIndex >= MAX_LINE_COUNT)
-            C->lineScrollIndex = 0;*/
+    direction = direction < 0 ? -1 : 1;
 
+    OGLCONSOLE_ScrollBy(C, 0);
+    line = OGLCONSOLE_FindLine(C, text, C->lineScrollIndex + direction,
+                               direction);
+    if (line < 0) return 0;
+
+    OGLCONSOLE_ScrollTo(C, line);
+    return 1;
 }
-#endif
 
 /* Adds a command to the console's command history, as though the user had
  * entered the command themselves, so it appears when they use up/down keys.
@@ -802,6 +7274,83 @@ void OGLCONSOLE_SetInputLine(const char *inputLine)
 #define MOD_CTRL            KMOD_CTRL
 // Is KMOD_MODE scroll-lock? what to do about KMOD_RESERVED?
 #define MOD_REJECT          (KMOD_ALT|KMOD_META|KMOD_MODE)
+
+/* The character a key types, with shift or caps lock */
+static int OGLCONSOLE_KeyCharacter(SDL_keysym *key)
+{
+    int k = key->sym;
+
+    /* Capitalize if necessary */
+    if (key->mod & MOD_CAPITALIZE)
+    {
+        static
+        const int capital[] = { (int)' ', (int)'!', (int)'"', (int)'#',
+            (int)'$', (int)'%', (int)'&', (int)'"', (int)'(', (int)')',
+            (int)'*', (int)'+', (int)'<', (int)'_', (int)'>', (int)'?',
+            (int)')', (int)'!', (int)'@', (int)'#', (int)'$', (int)'%',
+            (int)'^', (int)'&', (int)'*', (int)'(', (int)':', (int)':',
+            (int)'<', (int)'+', (int)'>', (int)'?', (int)'@', (int)'A',
+            (int)'B', (int)'C', (int)'D', (int)'E', (int)'F', (int)'G',
+            (int)'H', (int)'I', (int)'J', (int)'K', (int)'L', (int)'M',
+            (int)'N', (int)'O', (int)'P', (int)'Q', (int)'R', (int)'S',
+            (int)'T', (int)'U', (int)'V', (int)'W', (int)'X', (int)'Y',
+            (int)'Z', (int)'{', (int)'|', (int)'}', (int)'^', (int)'_',
+            (int)'~', (int)'A', (int)'B', (int)'C', (int)'D', (int)'E',
+            (int)'F', (int)'G', (int)'H', (int)'I', (int)'J', (int)'K',
+            (int)'L', (int)'M', (int)'N', (int)'O', (int)'P', (int)'Q',
+            (int)'R', (int)'S', (int)'T', (int)'U', (int)'V', (int)'W',
+            (int)'X', (int)'Y', (int)'Z', (int)'{', (int)'|', (int)'}',
+            (int)'~' };
+
+        /* If we're not explicitly holding a shift key, that means just
+         * capslock, which means we only capitalize letters */
+        if ((k >= 'a' && k <= 'z') || (key->mod & MOD_SHIFT))
+            k = capital[k-' '];
+    }
+
+    return k;
+}
+
+/* Send a key to a program running in a console, as a terminal would. Returns
+ * 0 if there's none, or the key is one the console keeps for itself: the hide
+ * key, and paging through the scrollback */
+static int OGLCONSOLE_ChildKey(_OGLCONSOLE_Console *console, SDL_keysym *key)
+{
+    static const struct { int sym; const char *s; } keys[] =
+    {
+        { KEY_RETURN, "\r" }, { KEY_BACKSPACE, "\x7f" }, { SDLK_TAB, "\t" },
+        { SDLK_ESCAPE, "\x1b" }, { KEY_DELETE, "\x1b[3~" },
+        { SDLK_INSERT, "\x1b[2~" }, { KEY_UP, "\x1b[A" },
+        { KEY_DOWN, "\x1b[B" }, { KEY_RIGHT, "\x1b[C" },
+        { KEY_LEFT, "\x1b[D" }, { KEY_HOME, "\x1b[H" }, { KEY_END, "\x1b[F" }
+    };
+    char c;
+    int i;
+
+    if (!OGLCONSOLE_ChildRunning(console) || key->sym == '`') return 0;
+
+    for (i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+        if (key->sym == keys[i].sym)
+        {
+            OGLCONSOLE_WriteChild(console, keys[i].s, strlen(keys[i].s));
+            return 1;
+        }
+
+    if (key->sym < ' ' || key->sym > '~') return 0;
+
+    c = OGLCONSOLE_KeyCharacter(key);
+
+    /* Control and a letter, or one of @[\]^_, is a control character */
+    if (key->mod & MOD_CTRL)
+    {
+        if ((c < '@' || c > '_') && (c < 'a' || c > 'z')) return 1;
+        c &= 0x1f;
+    }
+
+    OGLCONSOLE_WriteChild(console, &c, 1);
+    return 1;
+}
+
 int OGLCONSOLE_SDLEvent(SDL_Event *e)
 {
     /* If the terminal is hidden we only check for show/hide key */
@@ -828,10 +7377,23 @@ int OGLCONSOLE_SDLEvent(SDL_Event *e)
         /* Reject most modifier keys TODO: Add some accelerator keys? */
         if (e->key.keysym.mod & MOD_REJECT) return 0;
 
+        /* A program running in the console gets most keys */
+        if (OGLCONSOLE_ChildKey(userConsole, &e->key.keysym))
+            return 1;
+
         /* Handle Control modifier specially */
         if (e->key.keysym.mod & MOD_CTRL)
         {
-            /* TODO: Add Control+Key things here */
+            /* Control+R and Control+S search back and forward through the
+             * scrollback for whatever is on the input line */
+            if (e->key.keysym.sym == 'r' || e->key.keysym.sym == 's')
+            {
+                OGLCONSOLE_Find((void*)userConsole, userConsole->inputLine,
+                                e->key.keysym.sym == 'r' ? -1 : 1);
+                return 1;
+            }
+
+            /* TODO: Add more Control+Key things here */
             return 0;
         }
 
@@ -851,39 +7413,14 @@ int OGLCONSOLE_SDLEvent(SDL_Event *e)
         
         if (e->key.keysym.sym >= ' ' && e->key.keysym.sym <= '~')
         {
-            int k = e->key.keysym.sym;
+            int k;
             char *c, *d;
 
             /* Yank the command history if necessary */
             OGLCONSOLE_YankHistory(userConsole);
 
             /* Capitalize if necessary */
-            if (e->key.keysym.mod & MOD_CAPITALIZE)
-            {
-                static
-                const int capital[] = { (int)' ', (int)'!', (int)'"', (int)'#',
-                    (int)'$', (int)'%', (int)'&', (int)'"', (int)'(', (int)')',
-                    (int)'*', (int)'+', (int)'<', (int)'_', (int)'>', (int)'?',
-                    (int)')', (int)'!', (int)'@', (int)'#', (int)'$', (int)'%',
-                    (int)'^', (int)'&', (int)'*', (int)'(', (int)':', (int)':',
-                    (int)'<', (int)'+', (int)'>', (int)'?', (int)'@', (int)'A',
-                    (int)'B', (int)'C', (int)'D', (int)'E', (int)'F', (int)'G',
-                    (int)'H', (int)'I', (int)'J', (int)'K', (int)'L', (int)'M',
-                    (int)'N', (int)'O', (int)'P', (int)'Q', (int)'R', (int)'S',
-                    (int)'T', (int)'U', (int)'V', (int)'W', (int)'X', (int)'Y',
-                    (int)'Z', (int)'{', (int)'|', (int)'}', (int)'^', (int)'_',
-                    (int)'~', (int)'A', (int)'B', (int)'C', (int)'D', (int)'E',
-                    (int)'F', (int)'G', (int)'H', (int)'I', (int)'J', (int)'K',
-                    (int)'L', (int)'M', (int)'N', (int)'O', (int)'P', (int)'Q',
-                    (int)'R', (int)'S', (int)'T', (int)'U', (int)'V', (int)'W',
-                    (int)'X', (int)'Y', (int)'Z', (int)'{', (int)'|', (int)'}',
-                    (int)'~' };
-
-                /* If we're not explicitly holding a shift key, that means just
-                 * capslock, which means we only capitalize letters */
-                if ((k >= 'a' && k <= 'z') || (e->key.keysym.mod & MOD_SHIFT))
-                    k = capital[k-' '];
-            }
+            k = OGLCONSOLE_KeyCharacter(&e->key.keysym);
 
             /* Point to the cursor position and the end of the string */
             c = userConsole->inputLine + userConsole->inputCursorPos;
@@ -971,23 +7508,23 @@ int OGLCONSOLE_SDLEvent(SDL_Event *e)
         // Page up key
         else if (e->key.keysym.sym == KEY_PAGEUP)
         {
-            userConsole->lineScrollIndex -= min(userConsole->textHeight / 2, 5);
-
-            if (userConsole->lineScrollIndex < 0)
-                userConsole->lineScrollIndex += userConsole->maxLines;
+            OGLCONSOLE_GlideBy(userConsole,
+                    -min(userConsole->textHeight / 2, 5), 0);
 
-            printf("scroll index = %i\n", userConsole->lineScrollIndex);
+#ifdef DEBUG
+            printf("scroll index = %li\n", userConsole->lineScrollIndex);
+#endif
         }
 
         // Page down key
         else if (e->key.keysym.sym == KEY_PAGEDOWN)
         {
-            userConsole->lineScrollIndex += min(userConsole->textHeight / 2, 5);
+            OGLCONSOLE_GlideBy(userConsole,
+                    min(userConsole->textHeight / 2, 5), 0);
 
-            if (userConsole->lineScrollIndex >= userConsole->maxLines)
-                userConsole->lineScrollIndex -= userConsole->maxLines;
-
-            printf("scroll index = %i\n", userConsole->lineScrollIndex);
+#ifdef DEBUG
+            printf("scroll index = %li\n", userConsole->lineScrollIndex);
+#endif
         }
 
         // Home key
@@ -1016,8 +7553,7 @@ int OGLCONSOLE_SDLEvent(SDL_Event *e)
             // Shift key is for scrolling the output display
             if (e->key.keysym.mod & MOD_SHIFT)
             {
-                if (--userConsole->lineScrollIndex < 0)
-                    userConsole->lineScrollIndex = userConsole->maxLines-1;
+                OGLCONSOLE_GlideBy(userConsole, -1, 0);
             }
 
             // No shift key is for scrolling through command history
@@ -1052,8 +7588,7 @@ int OGLCONSOLE_SDLEvent(SDL_Event *e)
             // Shift key is for scrolling the output display
             if (e->key.keysym.mod & MOD_SHIFT)
             {
-                if (++userConsole->lineScrollIndex >= userConsole->maxLines)
-                    userConsole->lineScrollIndex = 0;
+                OGLCONSOLE_GlideBy(userConsole, 1, 0);
             }
 
             // No shift key is for scrolling through command history
@@ -1106,6 +7641,17 @@ int OGLCONSOLE_SDLEvent(SDL_Event *e)
         }
     }
 
+    /* The mouse wheel flings the scrollback */
+    else if (e->type == SDL_MOUSEBUTTONDOWN
+          && (e->button.button == SDL_BUTTON_WHEELUP
+           || e->button.button == SDL_BUTTON_WHEELDOWN))
+    {
+        OGLCONSOLE_GlideBy(userConsole,
+                e->button.button == SDL_BUTTON_WHEELUP ? -WHEEL_ROWS
+                                                       : WHEEL_ROWS, 1);
+        return 1;
+    }
+
     return 0;
 }
 #endif
@@ -25,10 +25,79 @@ void OGLCONSOLE_Quit();
 void OGLCONSOLE_Draw();
 void OGLCONSOLE_Render(OGLCONSOLE_Console console);
 
+/* With many consoles, call this each frame before rendering them: it gets
+ * every console that's going to be drawn ready at once, building their text
+ * on a thread per CPU, so that rendering them only sends it to the GL */
+void OGLCONSOLE_Prepare();
+
+/* How many threads Prepare() builds text on, counting the one calling it; 0
+ * (the default) means one per CPU, and 1 leaves it all to Render() */
+void OGLCONSOLE_SetBuildThreads(int threads);
+
 /* Print to the console */
 void OGLCONSOLE_Print(const char *s, ...);
 void OGLCONSOLE_Output(OGLCONSOLE_Console console, const char *s, ...);
 
+/* Output goes back to the start of the line after a carriage return ('\r'),
+ * writing over what's there. This replaces the whole line instead, for
+ * progress bars and such */
+void OGLCONSOLE_RewriteLine(OGLCONSOLE_Console console, const char *s, ...);
+
+/* Print to the console from any thread; it shows up the next time the console
+ * is drawn or printed to from the main thread */
+void OGLCONSOLE_QueueOutput(OGLCONSOLE_Console console, const char *s, ...);
+
+/* Print to every console in any of some broadcast groups, bit N for group N
+ * (see SetGroups below). It's formatted and stored just once however many
+ * consoles get it, and each line of it is a line of its own in them */
+void OGLCONSOLE_Broadcast(unsigned long groups, const char *s, ...);
+
+/* Output can also be tagged with a channel (0 through 31, whatever you like)
+ * and a severity, and each console decides which it wants to see */
+enum
+{
+    OGLCONSOLE_TRACE,
+    OGLCONSOLE_DEBUG,
+    OGLCONSOLE_INFO,
+    OGLCONSOLE_WARN,
+    OGLCONSOLE_ERROR,
+    OGLCONSOLE_SEVERITIES
+};
+
+/* Tagged output is thrown away before it's even formatted if the console
+ * doesn't want it. OGLCONSOLE_LOG() does that check inline, so unwanted output
+ * costs a single test; define OGLCONSOLE_MIN_SEVERITY to compile it out */
+void OGLCONSOLE_OutputTagged(OGLCONSOLE_Console console, int channel,
+                             int severity, const char *s, ...);
+
+#ifndef OGLCONSOLE_MIN_SEVERITY
+#define OGLCONSOLE_MIN_SEVERITY OGLCONSOLE_TRACE
+#endif
+
+#define OGLCONSOLE_LOG(console, channel, severity, ...) \
+    do { if (OGLCONSOLE_WANTS(console, channel, severity)) \
+        OGLCONSOLE_OutputTagged(console, channel, severity, __VA_ARGS__); \
+    } while (0)
+
+/* Every console begins with its filter, which is all OGLCONSOLE_WANTS() looks
+ * at: bit N of mask[S] is set if channel N gets output of severity S */
+struct _OGLCONSOLE_Filter { unsigned long mask[OGLCONSOLE_SEVERITIES]; };
+
+/* Channels and severities out of range are never wanted */
+#define OGLCONSOLE_CHANNELS 32
+
+#define OGLCONSOLE_WANTS(console, channel, severity) \
+    ((severity) >= OGLCONSOLE_MIN_SEVERITY && \
+     (unsigned)(severity) < OGLCONSOLE_SEVERITIES && \
+     (unsigned)(channel) < OGLCONSOLE_CHANNELS && \
+     (((const struct _OGLCONSOLE_Filter*)(console))->mask[severity] \
+        & 1ul << (channel)))
+
+/* Sets the least severe output a channel of the console being edited will
+ * show, taking effect immediately; a channel of -1 means all of them, and any
+ * other channel outside 0 through 31 is ignored */
+void OGLCONSOLE_SetFilter(int channel, int minSeverity);
+
 /* Register a callback with the console */
 void OGLCONSOLE_EnterKey(void(*cbfun)(OGLCONSOLE_Console console, char *cmd));
 
@@ -51,6 +120,129 @@ void OGLCONSOLE_EditConsole(OGLCONSOLE_Console console);
 /* Sets the dimensions of the console in lines and columns of characters. */
 void OGLCONSOLE_SetDimensions(int width, int height);
 
+/* Sets how many lines of output the console remembers for scrolling back */
+void OGLCONSOLE_SetScrollback(int lines);
+
+/* Keeps the console's scrollback in a memory-mapped file (plus an index of it
+ * in path.idx) so it survives restarts. Returns 0 if that isn't possible */
+int OGLCONSOLE_SetScrollbackFile(const char *path);
+
+/* When a line of output repeats one of the last few lines (up to 16), show a
+ * count on the earlier line instead of the repeat. 0, the default, is off */
+void OGLCONSOLE_SetCoalesce(int lines);
+
+/* Spend at most this many microseconds a frame putting output into the
+ * scrollback, so that a flood of output doesn't hold up a frame; the rest
+ * waits, and the console shows how much is waiting. 0, the default, is no
+ * limit. GetBacklog tells how many bytes are waiting */
+void OGLCONSOLE_SetDrainBudget(unsigned int microseconds);
+int OGLCONSOLE_GetBacklog();
+
+/* Which broadcast groups the console belongs to, bit N for group N. 0, the
+ * default, is none */
+void OGLCONSOLE_SetGroups(unsigned long groups);
+
+/* Every line remembers when it was started, and the channel and severity of
+ * the tagged output which started it. Lines of each severity are drawn in a
+ * color of their own. The gutter shows some of this to the left of lines;
+ * 0, the default, shows none of it */
+enum
+{
+    OGLCONSOLE_GUTTER_TIME = 1,
+    OGLCONSOLE_GUTTER_SEVERITY = 2,
+    OGLCONSOLE_GUTTER_CHANNEL = 4
+};
+void OGLCONSOLE_SetGutter(int flags);
+
+/* Color codes in output color the text after them, and are taken out of it:
+ * ANSI escape sequences (foreground colors, in 16, 256 or 24 bit colors; other
+ * sequences are thrown away) and Quake's ^0 to ^9, which last until the end of
+ * the line. Only ANSI codes are understood by default */
+enum
+{
+    OGLCONSOLE_COLORS_ANSI = 1,
+    OGLCONSOLE_COLORS_QUAKE = 2
+};
+void OGLCONSOLE_SetColorCodes(int flags);
+
+/* In terminal mode, output is drawn on a screen the size of the console like
+ * on a VT100 terminal, with escape sequences moving the cursor, erasing,
+ * scrolling and coloring, so full screen programs can run in it. A newline
+ * only moves down a row unless ESC [ 20 h is output. Rows scrolled off the
+ * top of the screen still go into the scrollback, which shows in its place
+ * when scrolled back. The alternate screen (ESC [ ? 1049 h and friends) is a
+ * blank one, and the screen from before comes back when it's switched off.
+ * Returns 0 if there's no memory for it */
+int OGLCONSOLE_SetTerminal(int on);
+
+/* Run a program (a command line for /bin/sh) in the console, on a
+ * pseudo-terminal, in terminal mode. Its output streams into the console
+ * without the program ever being waited for, and keys typed into the console
+ * go to it until it exits. A program outputting faster than the console keeps
+ * up with is slowed down to match. StopChild() hangs up on it. RunChild()
+ * returns 0 if it couldn't be started, or isn't possible here */
+int OGLCONSOLE_RunChild(const char *command);
+void OGLCONSOLE_StopChild();
+
+/* Show only lines at least minSeverity, and tagged lines only from the
+ * channels in channels (bit N for channel N); untagged lines count as
+ * OGLCONSOLE_INFO. OGLCONSOLE_TRACE and ~0ul show them all again. This goes
+ * along with SetGrep(). Returns 0 if there's no memory for it */
+int OGLCONSOLE_SetShownTags(int minSeverity, unsigned long channels);
+
+/* Show only lines of output matching a regular expression, like a live grep;
+ * NULL or "" shows everything again. Returns 0 if the expression is bad */
+int OGLCONSOLE_SetGrep(const char *pattern);
+
+/* Pin up to 8 rows of text to the bottom of the console (or the top), which
+ * stay put while scrollback goes by. Rows are numbered from the top one, and
+ * can be set like Print(), or made to watch a variable: every interval ms it's
+ * looked at, and formatted with format if it has changed */
+enum
+{
+    OGLCONSOLE_WATCH_INT,
+    OGLCONSOLE_WATCH_LONG,
+    OGLCONSOLE_WATCH_FLOAT,
+    OGLCONSOLE_WATCH_DOUBLE
+};
+
+void OGLCONSOLE_SetPinnedRows(int rows, int top);
+void OGLCONSOLE_SetPinned(int slot, const char *s, ...);
+void OGLCONSOLE_Watch(int slot, const char *format, int type,
+                      const void *variable, int interval);
+
+/* Capture stdout and stderr, so whatever anything prints to them shows up in
+ * the console (and, with passThrough, still where it went before). Returns 0
+ * if that isn't possible. stdout is flushed each time the console is drawn, so
+ * what's printed to it shows up within a frame even though it's buffered */
+int OGLCONSOLE_CaptureStdio(int passThrough);
+void OGLCONSOLE_StopCapture();
+
+/* Captured output which comes faster than the console takes it is dropped once
+ * a megabyte of it is waiting. This tells how many bytes have been */
+unsigned long OGLCONSOLE_GetCaptureDropped();
+
+/* Copy console output to a file, stdout, or a function of your own as well.
+ * Sinks are written to by a background thread, so output never waits on them;
+ * callbacks are called from that thread. These return 0 on failure */
+int OGLCONSOLE_AddFileSink(const char *path);
+int OGLCONSOLE_AddStdoutSink();
+int OGLCONSOLE_AddCallbackSink(void(*cbfun)(OGLCONSOLE_Console console,
+                                            const char *text, int length,
+                                            void *data),
+                               void *data);
+
+/* If sinks can't keep up, output to them is dropped unless blocking is set, in
+ * which case output waits for them. This tells how many bytes were dropped */
+void OGLCONSOLE_SetSinkBlocking(int block);
+unsigned long OGLCONSOLE_GetSinkDropped();
+
+/* Scroll back (direction -1) or forward (1) to the next line of output which
+ * contains text, ignoring case. Returns 0 if there isn't one. Control+R and
+ * Control+S do this for whatever is on the input line */
+int OGLCONSOLE_Find(OGLCONSOLE_Console console, const char *text,
+                    int direction);
+
 /* Use this if you want to populate console command history yourself */
 void OGLCONSOLE_AddHistory(OGLCONSOLE_Console console, char *s);
 
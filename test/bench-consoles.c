@@ -0,0 +1,99 @@
+/* How long it takes to draw 64 consoles each frame: rendering each on its
+ * own, and with Prepare() first, building on this thread alone and on a
+ * thread per CPU. The consoles either have a new line of scrollback a frame,
+ * or are terminals with their whole screen rewritten every frame, which is a
+ * lot of text to build. The time is the CPU's side of drawing only, since the
+ * GL here does nothing with what it's sent */
+
+#define HEADLESS_TIMING
+#include "headless.h"
+
+#define CONSOLES 64
+#define FRAMES 200
+
+static OGLCONSOLE_Console consoles[CONSOLES];
+
+/* Fill the consoles' scrollback and show them all, as terminals or not */
+static void Open(int terminals)
+{
+    OGLCONSOLE_Console console;
+    int i, j;
+
+    for (i = 0; i < CONSOLES; i++)
+    {
+        console = consoles[i] = OGLCONSOLE_Create();
+        C->visible = 1;
+        C->transitionComplete = 0;
+
+        OGLCONSOLE_EditConsole(console);
+        OGLCONSOLE_SetTerminal(terminals);
+
+        for (j = 0; j < 400; j++)
+            OGLCONSOLE_Output(console, "console %d line %d the quick \x1b[31m"
+                              "brown fox\x1b[0m jumps over the lazy dog\n",
+                              i, j);
+    }
+}
+
+/* Give a console this frame's output */
+static void Update(OGLCONSOLE_Console console, int terminals, int frame)
+{
+    int row;
+
+    if (!terminals)
+    {
+        OGLCONSOLE_Output(console, "frame %d\n", frame);
+        return;
+    }
+
+    for (row = 1; row <= C->terminal->rows; row++)
+        OGLCONSOLE_Output(console, "\x1b[%d;1H\x1b[3%dmframe %d row %d %s"
+                          "%s\x1b[0m", row, (frame + row) % 8, frame, row,
+                          "the quick brown fox jumps over the lazy dog ",
+                          "and then the quick brown fox does it again");
+}
+
+/* Draw the consoles for a while, with Prepare() building on threads threads,
+ * or without it if threads is -1 */
+static void Run(const char *what, int terminals, int threads)
+{
+    double t = 0, start;
+    int f, i;
+
+    Open(terminals);
+    OGLCONSOLE_SetBuildThreads(max(threads, 0));
+
+    for (f = 0; f < FRAMES; f++)
+    {
+        for (i = 0; i < CONSOLES; i++)
+            Update(consoles[i], terminals, f);
+
+        start = Seconds();
+        if (threads >= 0)
+            OGLCONSOLE_Prepare();
+        for (i = 0; i < CONSOLES; i++)
+            OGLCONSOLE_Render(consoles[i]);
+        t += Seconds() - start;
+    }
+
+    printf("%-38s %8.1f us/frame\n", what, t * 1e6 / FRAMES);
+    OGLCONSOLE_Quit();
+}
+
+int main()
+{
+    int terminals;
+
+    printf("%ld CPUs\n", sysconf(_SC_NPROCESSORS_ONLN));
+
+    for (terminals = 0; terminals < 2; terminals++)
+    {
+        printf("%s:\n", terminals ? "Terminals, whole screen a frame"
+                                  : "Scrollback, a line a frame");
+        Run("  Render() alone", terminals, -1);
+        Run("  Prepare() + Render(), one thread", terminals, 1);
+        Run("  Prepare() + Render(), a thread/CPU", terminals, 0);
+    }
+
+    return 0;
+}
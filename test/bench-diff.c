@@ -0,0 +1,134 @@
+/* How long it takes to find what changed on a 480x270 terminal screen each
+ * frame, and how many rows' display lists that rebuilds, for the sorts of
+ * output full screen programs make. After each kind, what the lists draw is
+ * checked against the screen */
+
+#define HEADLESS_TIMING
+#include "headless.h"
+
+static OGLCONSOLE_Console console;
+static int rebuilt;
+
+/* Run the diff for a frame, counting the rows it rebuilds */
+static double Frame()
+{
+    double t = Seconds();
+    int i;
+
+    C->batchCount = C->stepCount = 0;
+    OGLCONSOLE_UpdateFront(C);
+    t = Seconds() - t;
+
+    for (i = 0; i < C->stepCount; i++)
+        if (C->steps[i].type == STEP_COMPILE)
+            rebuilt++;
+
+    return t;
+}
+
+/* Rows where what's drawn doesn't match what's on the screen */
+static int Mismatched()
+{
+    OGLCONSOLE_Terminal *t = C->terminal;
+    int w = t->columns, r, n = 0;
+
+    for (r = 0; r < t->rows; r++)
+        if (memcmp(t->cells + r * w, t->frontCells + r * w, w)
+         || memcmp(t->colors + r * w, t->frontColors + r * w,
+                   w * sizeof(unsigned int)))
+            n++;
+
+    return n;
+}
+
+static void Report(const char *what, double t, int frames)
+{
+    printf("%-26s %8.1f us/frame %6.1f rows rebuilt/frame", what,
+           t * 1e6 / frames, rebuilt / (double)frames);
+
+    if (Mismatched())
+        printf(", %d rows wrong", Mismatched());
+    printf("\n");
+
+    rebuilt = 0;
+}
+
+int main()
+{
+    const char *fox = "the quick brown fox jumps over the lazy dog ";
+    char line[512];
+    double t;
+    int i;
+
+    console = OGLCONSOLE_Create();
+    C->textWidth = 480;
+    C->textHeight = 270;
+    if (!OGLCONSOLE_SetTerminal(1)) return 1;
+
+    for (i = 0; i < 300; i++)
+        OGLCONSOLE_Output(console, "\x1b[3%dmline %d %s%s%s%s%s%s%s%s\r\n",
+                          i % 8, i, fox, fox, fox, fox, fox, fox, fox, fox);
+    Report("first frame", Frame(), 1);
+
+    for (t = 0, i = 0; i < 1000; i++)
+        t += Frame();
+    Report("nothing changed", t, 1000);
+
+    for (t = 0, i = 0; i < 1000; i++)
+    {
+        OGLCONSOLE_Output(console, "\x1b[100;100H%c", 'A' + i % 26);
+        t += Frame();
+    }
+    Report("one cell", t, 1000);
+
+    for (t = 0, i = 0; i < 1000; i++)
+    {
+        OGLCONSOLE_Output(console, "\x1b[100;1Hline 99");
+        t += Frame();
+    }
+    Report("same text rewritten", t, 1000);
+
+    memset(line, 'z', 300);
+    line[300] = 0;
+    OGLCONSOLE_Output(console, "\x1b[270;1H");
+    for (t = 0, i = 0; i < 1000; i++)
+    {
+        OGLCONSOLE_Output(console, "new line %d %s\r\n", i, line);
+        t += Frame();
+    }
+    Report("full screen scroll by 1", t, 1000);
+
+    for (t = 0, i = 0; i < 300; i++)
+    {
+        OGLCONSOLE_Output(console, "new line %d %s\r\n", i, line);
+        OGLCONSOLE_Output(console, "new line %d %s\r\n", i, line);
+        OGLCONSOLE_Output(console, "new line %d %s\r\n", i, line);
+        t += Frame();
+    }
+    Report("full screen scroll by 3", t, 300);
+
+    for (t = 0, i = 0; i < 300; i++)
+    {
+        OGLCONSOLE_Output(console, "\x1b[1;1Hstatus %d\x1b[5;200r\x1b[200;1H"
+                                   "\n%d\x1b[r", i, i);
+        t += Frame();
+    }
+    Report("region scroll + status", t, 300);
+
+    for (t = 0, i = 0; i < 300; i++)
+    {
+        OGLCONSOLE_Output(console, "\x1b[H\x1bM");
+        t += Frame();
+    }
+    Report("reverse scroll", t, 300);
+
+    for (t = 0, i = 0; i < 100; i++)
+    {
+        OGLCONSOLE_Output(console, "\x1b[2J\x1b[H%d", i);
+        t += Frame();
+    }
+    Report("clear screen", t, 100);
+
+    OGLCONSOLE_Quit();
+    return 0;
+}
@@ -0,0 +1,57 @@
+/* A synthetic log storm: two subsystems complain every frame, and every so
+ * often something worth reading is printed in between. Run with and without
+ * coalescing, this shows what a line of output costs and how much of the
+ * useful output survives in the scrollback */
+
+#define HEADLESS_TIMING
+#include "headless.h"
+
+#define FRAMES 1000000
+#define USEFUL_EVERY 1000
+
+static void Storm(int coalesce)
+{
+    OGLCONSOLE_Console console = OGLCONSOLE_Create();
+    long line, lines = 0, useful = 0, first = C->lineQueueIndex;
+    double t;
+    int i, n;
+
+    OGLCONSOLE_EditConsole(console);
+    OGLCONSOLE_SetCoalesce(coalesce);
+
+    t = Seconds();
+    for (i = 0; i < FRAMES; i++)
+    {
+        OGLCONSOLE_Output(console, "physics: frame took too long\n");
+        OGLCONSOLE_Output(console, "net: timeout waiting for server\n");
+        lines += 2;
+
+        if (i % USEFUL_EVERY == 0)
+        {
+            OGLCONSOLE_Output(console, "checkpoint %d reached\n", i);
+            lines++;
+        }
+    }
+    t = Seconds() - t;
+
+    for (line = OGLCONSOLE_FirstLine(C); line <= C->lineQueueIndex; line++)
+    {
+        const char *s = OGLCONSOLE_LineText(C, line, &n);
+        if (n > 10 && !memcmp(s, "checkpoint", 10))
+            useful++;
+    }
+
+    printf("coalesce %2d: %6.1f ns/line, %ld lines scrolled in, "
+           "%ld of %d useful lines kept\n", coalesce, t * 1e9 / lines,
+           C->lineQueueIndex - first, useful, FRAMES / USEFUL_EVERY);
+
+    OGLCONSOLE_Quit();
+}
+
+int main()
+{
+    Storm(0);
+    Storm(4);
+    Storm(16);
+    return 0;
+}
@@ -0,0 +1,135 @@
+/* How well cold scrollback blocks compress, and how fast they are packed and
+ * unpacked again, for a few sorts of output. Each block is checked to come
+ * back out of OGLCONSOLE_Unpack() the same as it went in */
+
+#define HEADLESS_TIMING
+#include "headless.h"
+
+#define BLOCKS 256
+#define REPS 8
+
+/* Room for a block which doesn't compress, and the little the codec adds */
+#define PACKED_SIZE (OGLCONSOLE_PAGE_SIZE + OGLCONSOLE_PAGE_SIZE / 128)
+
+static char text[BLOCKS][OGLCONSOLE_PAGE_SIZE];
+static int used[BLOCKS];
+
+/* Fill the blocks with lines from one of the kinds of output below, breaking
+ * them where whole lines no longer fit, as Output() does */
+static void Fill(int (*line)(char *s, long i))
+{
+    char s[MAX_LINE_LENGTH];
+    long i = 0;
+    int b, n;
+
+    srand(1);
+    for (b = 0; b < BLOCKS; b++)
+        for (used[b] = 0;
+             (n = line(s, i)) <= OGLCONSOLE_PAGE_SIZE - used[b]; i++)
+        {
+            memcpy(text[b] + used[b], s, n);
+            used[b] += n;
+        }
+}
+
+/* A program logging as it goes: timestamps, counters, addresses */
+static int Log(char *s, long i)
+{
+    static const char *what[] = { "net", "physics", "audio", "render" };
+
+    return sprintf(s, "[%10.4f] %s: frame %ld, %d bytes from 10.0.%d.%d:%d\n",
+                   i * 0.0167, what[rand() % 4], i, rand() % 65536,
+                   rand() % 256, rand() % 256, 1024 + rand() % 60000);
+}
+
+/* The same couple of warnings over and over, each with a frame number */
+static int Spam(char *s, long i)
+{
+    return sprintf(s, i % 2 ? "physics: frame %ld took too long\n"
+                            : "net: timeout waiting for server (frame %ld)\n",
+                   i / 2);
+}
+
+/* A compiler working through a source tree */
+static int Build(char *s, long i)
+{
+    static const char *dirs[] = { "src/render", "src/net", "src/game",
+                                  "lib/util", "lib/physics" };
+    static const char *files[] = { "main", "world", "entity", "socket",
+                                   "shader", "mesh", "collide", "vector" };
+
+    if (rand() % 8)
+        return sprintf(s, "cc -O2 -Wall -Iinclude -c %s/%s.c -o %s/%s.o\n",
+                       dirs[i % 5], files[i % 8], dirs[i % 5], files[i % 8]);
+
+    return sprintf(s, "%s/%s.c:%d:%d: warning: unused variable 'tmp%d'\n",
+                   dirs[i % 5], files[i % 8], rand() % 2000, rand() % 80,
+                   rand() % 100);
+}
+
+/* Hex dumps of random data, which hardly compress at all */
+static int Hex(char *s, long i)
+{
+    int j, n = sprintf(s, "%08lx:", i * 16);
+
+    for (j = 0; j < 16; j++)
+        n += sprintf(s + n, " %02x", rand() % 256);
+    s[n++] = '\n';
+    return n;
+}
+
+static int Bench(const char *what, int (*line)(char *s, long i))
+{
+    static unsigned char packed[BLOCKS][PACKED_SIZE];
+    static unsigned char unpacked[OGLCONSOLE_PAGE_SIZE];
+    static int size[BLOCKS];
+    long in = 0, out = 0, kept = 0;
+    double pack, unpack;
+    int b, r, wrong = 0;
+
+    Fill(line);
+
+    pack = Seconds();
+    for (r = 0; r < REPS; r++)
+        for (b = 0; b < BLOCKS; b++)
+            size[b] = OGLCONSOLE_Pack((unsigned char*)text[b], used[b],
+                                      packed[b], PACKED_SIZE);
+    pack = Seconds() - pack;
+
+    unpack = Seconds();
+    for (r = 0; r < REPS; r++)
+        for (b = 0; b < BLOCKS; b++)
+            if (OGLCONSOLE_Unpack(packed[b], size[b], unpacked,
+                                  OGLCONSOLE_PAGE_SIZE) != used[b]
+             || memcmp(unpacked, text[b], used[b]))
+                wrong++;
+    unpack = Seconds() - unpack;
+
+    /* OGLCONSOLE_PackBlock() keeps blocks raw unless they shrink by an
+     * eighth, so count what a console would actually hold */
+    for (b = 0; b < BLOCKS; b++)
+    {
+        in += used[b];
+        out += size[b] && size[b] <= used[b] - used[b] / 8 ? size[b] : used[b];
+        kept += size[b] && size[b] <= used[b] - used[b] / 8;
+    }
+
+    printf("%-9s %5.2fx, %3ld of %d blocks packed, "
+           "pack %4.0f MB/s, unpack %5.0f MB/s\n", what, (double)in / out,
+           kept, BLOCKS, in * REPS / pack / 1e6, in * REPS / unpack / 1e6);
+
+    if (wrong)
+        printf("  %d blocks came back wrong\n", wrong);
+
+    return wrong;
+}
+
+int main()
+{
+    int wrong = Bench("log", Log);
+
+    wrong += Bench("spam", Spam);
+    wrong += Bench("build", Build);
+    wrong += Bench("hex dump", Hex);
+    return wrong != 0;
+}
@@ -0,0 +1,69 @@
+/* How fast glyphs become quads, in glyphs per microsecond:
+ * OGLCONSOLE_RowQuads() filling a vertex array with a row at a time, against
+ * the per-glyph loop it replaced, which made eight immediate mode calls for
+ * each glyph. Without a context those calls go nowhere, so the old loop's
+ * numbers are if anything better than it ever did */
+
+#define HEADLESS_TIMING
+#include "headless.h"
+
+#define REPS 20000
+
+/* The per-glyph function as it was */
+static void OldCharacter(unsigned char c, double x, double y, double w,
+                         double h, double z)
+{
+    double cx = (c % 16) * CHAR_WIDTH, cX = cx + CHAR_WIDTH,
+           cY = (c / 16) * CHAR_HEIGHT, cy = cY + CHAR_HEIGHT;
+
+    glTexCoord2d(cx, cy); glVertex3d(x,     y,     z);
+    glTexCoord2d(cX, cy); glVertex3d(x + w, y,     z);
+    glTexCoord2d(cX, cY); glVertex3d(x + w, y + h, z);
+    glTexCoord2d(cx, cY); glVertex3d(x,     y + h, z);
+}
+
+int main()
+{
+    static const int lengths[] = { 16, 80, 160, 480 };
+    static unsigned char row[520];
+    static float quads[512 * 16];
+    float check = 0;
+    double old, rows, x;
+    int i, j, l, n;
+
+    for (i = 0; i < (int)sizeof(row); i++)
+        row[i] = 32 + i * 7 % 95;
+
+    OGLCONSOLE_InitGlyphs();
+
+    for (l = 0; l < (int)(sizeof(lengths) / sizeof(lengths[0])); l++)
+    {
+        n = lengths[l];
+
+        old = Seconds();
+        for (j = 0; j < REPS; j++)
+        {
+            glBegin(GL_QUADS);
+            for (i = 0, x = 0; i < n; i++, x += 1.0 / 160)
+                OldCharacter(row[i + j % 8], x, 0.5, 1.0 / 160, 1.0 / 60, 0);
+            glEnd();
+        }
+        old = Seconds() - old;
+
+        rows = Seconds();
+        for (j = 0; j < REPS; j++)
+        {
+            OGLCONSOLE_RowQuads(row + j % 8, n, 0, 0.5f, 1.0f / 160,
+                                1.0f / 60, quads);
+            check += quads[n * 16 - 1];
+        }
+        rows = Seconds() - rows;
+
+        printf("%3d glyph rows: per-glyph calls %6.1f glyphs/us, "
+               "RowQuads %6.1f glyphs/us\n", n, (double)n * REPS / old / 1e6,
+               (double)n * REPS / rows / 1e6);
+    }
+
+    /* So that the quads can't be left unmade */
+    return check < 0;
+}
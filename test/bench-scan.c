@@ -0,0 +1,87 @@
+/* How fast output is scanned for the characters that end a run of plain text,
+ * by OGLCONSOLE_FindSpecial() against the byte at a time loop it replaced, on
+ * long log lines; and how fast Output() takes those lines as a whole. The two
+ * scans are checked against each other on random text first */
+
+#define HEADLESS_TIMING
+#include "headless.h"
+
+#define LINE 4096
+#define REPS 200000
+#define TRIALS 20000
+
+/* The loop output used to be scanned with */
+static const char *ByteLoop(const char *s, const char *end)
+{
+    while (s < end && !OGLCONSOLE_SPECIAL(*s))
+        s++;
+
+    return s;
+}
+
+int main()
+{
+    static char text[LINE];
+    OGLCONSOLE_Console console;
+    const char *p, *end = text + LINE;
+    double byteLoop, findSpecial;
+    long i, wrong = 0;
+    int j;
+
+    /* Random text with the odd special character in it */
+    srand(1);
+    for (i = 0; i < TRIALS; i++)
+    {
+        int start = rand() % LINE;
+
+        for (j = 0; j < LINE; j++)
+        {
+            int r = rand() % 200;
+            text[j] = r < 6 ? "\n\r\t\0\x1b^"[r] : 'a' + r % 26;
+        }
+
+        if (OGLCONSOLE_FindSpecial(text + start, end)
+         != ByteLoop(text + start, end))
+            wrong++;
+    }
+
+    if (wrong)
+    {
+        printf("FindSpecial disagreed with the byte loop %ld times\n", wrong);
+        return 1;
+    }
+
+    /* Long log lines: a newline every 400 bytes */
+    memset(text, 'x', LINE - 1);
+    text[LINE - 1] = 0;
+    for (j = 200; j < LINE - 1; j += 400)
+        text[j] = '\n';
+
+    byteLoop = Seconds();
+    for (i = 0; i < REPS; i++)
+        for (p = text; *(p = ByteLoop(p, end)); p++);
+    byteLoop = Seconds() - byteLoop;
+
+    findSpecial = Seconds();
+    for (i = 0; i < REPS; i++)
+        for (p = text; *(p = OGLCONSOLE_FindSpecial(p, end)); p++);
+    findSpecial = Seconds() - findSpecial;
+
+    printf("scan: byte loop %.0f MB/s, FindSpecial %.0f MB/s\n",
+           REPS * (LINE - 1.0) / byteLoop / 1e6,
+           REPS * (LINE - 1.0) / findSpecial / 1e6);
+
+    /* The whole of Output() */
+    console = OGLCONSOLE_Create();
+    OGLCONSOLE_SetScrollback(100000);
+
+    findSpecial = Seconds();
+    for (i = 0; i < REPS / 2; i++)
+        OGLCONSOLE_Output(console, "%s", text);
+    findSpecial = Seconds() - findSpecial;
+
+    printf("Output: %.0f MB/s\n", REPS / 2 * (LINE - 1.0) / findSpecial / 1e6);
+
+    OGLCONSOLE_Quit();
+    return 0;
+}
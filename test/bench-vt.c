@@ -0,0 +1,51 @@
+/* How fast a terminal takes output, in MB/s, on a recorded stream that's a
+ * mix of a colored build log, a top-like screen being redrawn, scrolling
+ * within a region, and plain lines. It goes in 4 KB at a time, as it would
+ * from a program running on a pseudo-terminal */
+
+#define HEADLESS_TIMING
+#include "headless.h"
+
+#define STREAM (64 * 1024 * 1024)
+
+int main()
+{
+    OGLCONSOLE_Console console = OGLCONSOLE_Create();
+    char *stream = malloc(STREAM + 256), *p = stream;
+    double t;
+    long i, n;
+
+    if (!stream || !OGLCONSOLE_SetTerminal(1)) return 1;
+
+    srand(1);
+    while (p - stream < STREAM)
+    {
+        int r = rand() % 10;
+
+        if (r < 5)
+            p += sprintf(p, "\x1b[3%dmcc -O2 -c src/module%d.c -o "
+                         "obj/module%d.o\x1b[0m\r\n",
+                         rand() % 8, rand(), rand());
+        else if (r < 7)
+            p += sprintf(p, "\x1b[%d;1H\x1b[K%5d root 20 0 %8d %6d S %4.1f top",
+                         rand() % 60 + 1, rand() % 99999, rand(),
+                         rand() % 99999, (rand() % 1000) / 10.0);
+        else if (r < 8)
+            p += sprintf(p, "\x1b[1;24r\x1b[24;1H\n\x1b[r\x1b[H\x1b[2K");
+        else
+            p += sprintf(p, "plain text line number %d with nothing special "
+                         "on it at all\r\n", rand());
+    }
+    n = p - stream;
+
+    t = Seconds();
+    for (i = 0; i < n; i += 4096)
+        OGLCONSOLE_Ingest(C, stream + i, min(4096, n - i));
+    t = Seconds() - t;
+
+    printf("terminal: %.1f MB/s\n", n / t / 1e6);
+
+    free(stream);
+    OGLCONSOLE_Quit();
+    return 0;
+}
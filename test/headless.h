@@ -0,0 +1,39 @@
+/* The programs in this directory build oglconsole.c right into themselves, so
+ * that they can look at its insides, and run it without a window. There's no
+ * GL context either: display lists are handed out here, as the GL wouldn't
+ * give out any, the few GL queries the console makes outside of drawing are
+ * answered here, and drawing itself goes nowhere */
+
+static unsigned int HeadlessGenLists(int range);
+#define glGenLists HeadlessGenLists
+
+#include "../oglconsole.c"
+
+#undef glGenLists
+
+static unsigned int HeadlessGenLists(int range)
+{
+    static unsigned int next = 1;
+
+    next += range;
+    return next - range;
+}
+
+void glGetIntegerv(GLenum pname, GLint *params)
+{
+    /* Only the viewport is ever asked for */
+    params[0] = params[1] = 0;
+    params[2] = 640;
+    params[3] = 480;
+}
+
+#ifdef HEADLESS_TIMING
+/* Wall clock time in seconds, for the benchmarks, which define HEADLESS_TIMING
+ * before including this */
+static double Seconds()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+#endif
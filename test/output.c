@@ -0,0 +1,91 @@
+/* Checks that output reaches the scrollback in the order it was made, with a
+ * drain budget holding some of it back in the backlog. Prints what doesn't
+ * match, and exits with 1 if anything didn't */
+
+#include "headless.h"
+
+static int failures = 0;
+
+/* The lines from first on in the scrollback should be these */
+static void ExpectLines(OGLCONSOLE_Console console, const char *test,
+                        long first, const char **lines)
+{
+    const char *s;
+    long i;
+    int n;
+
+    for (i = first; *lines; i++, lines++)
+    {
+        if (i <= C->lineQueueIndex)
+            s = OGLCONSOLE_LineText(C, i, &n);
+        else
+            s = "", n = 0;
+
+        if (n != (int)strlen(*lines) || memcmp(s, *lines, n))
+        {
+            printf("%s: line %ld is \"%.*s\", not \"%s\"\n", test, i, n, s,
+                   *lines);
+            failures++;
+        }
+    }
+}
+
+int main()
+{
+    static const char *rewritten[] = { "old 0", "old 1", "progress 2", "next",
+                                       NULL },
+                      *broadcast[] = { "waiting 0", "waiting 1", "shared",
+                                       "after", NULL };
+    OGLCONSOLE_Console console = OGLCONSOLE_Create(), other;
+    long first;
+
+    OGLCONSOLE_EditConsole(console);
+    OGLCONSOLE_SetDrainBudget(1);
+
+    /* Rewriting replaces the line the waiting output ends on */
+    first = C->lineQueueIndex + 1;
+    OGLCONSOLE_Output(console, "old 0\nold 1\nprogress 0");
+    OGLCONSOLE_Output(console, "\rprogress 1");
+    OGLCONSOLE_RewriteLine(console, "progress 2");
+    OGLCONSOLE_Output(console, "\nnext\n");
+    OGLCONSOLE_SetDrainBudget(0);
+    OGLCONSOLE_Output(console, "");
+    ExpectLines(console, "rewrite", first, rewritten);
+
+    /* Broadcast lines come after what was waiting, in every console */
+    other = OGLCONSOLE_Create();
+    OGLCONSOLE_SetGroups(1);
+    OGLCONSOLE_EditConsole(other);
+    OGLCONSOLE_SetGroups(1);
+    OGLCONSOLE_SetDrainBudget(1);
+    OGLCONSOLE_EditConsole(console);
+    OGLCONSOLE_SetDrainBudget(1);
+
+    first = C->lineQueueIndex + 1;
+    OGLCONSOLE_Output(console, "waiting 0\nwaiting 1\n");
+    OGLCONSOLE_Output(other, "waiting 0\nwaiting 1\n");
+    OGLCONSOLE_Broadcast(1, "shared\n");
+    OGLCONSOLE_Output(console, "after\n");
+    OGLCONSOLE_Output(other, "after\n");
+    OGLCONSOLE_SetDrainBudget(0);
+    OGLCONSOLE_Output(console, "");
+    ExpectLines(console, "broadcast", first, broadcast);
+
+    OGLCONSOLE_EditConsole(other);
+    OGLCONSOLE_SetDrainBudget(0);
+    OGLCONSOLE_Output(other, "");
+    ExpectLines(other, "broadcast other",
+                ((_OGLCONSOLE_Console*)other)->lineQueueIndex - 3, broadcast);
+
+    OGLCONSOLE_EditConsole(console);
+    OGLCONSOLE_Destroy(other);
+    OGLCONSOLE_Quit();
+
+    if (failures)
+    {
+        printf("%d failed\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+/* Checks that display lists a console's plan was to compile are compiled by a
+ * later plan if that one is never drawn, as when the program skips rendering
+ * a console it called Prepare() for. Prints what doesn't match, and exits
+ * with 1 if anything didn't */
+
+#include "headless.h"
+
+static int failures = 0;
+
+/* How many display lists a console's plan compiles */
+static int Compiles(OGLCONSOLE_Console console)
+{
+    int i, n = 0;
+
+    for (i = 0; i < C->stepCount; i++)
+        if (C->steps[i].type == STEP_COMPILE)
+            n++;
+
+    return n;
+}
+
+static void Expect(const char *test, int ok, const char *what)
+{
+    if (!ok)
+    {
+        printf("%s: %s\n", test, what);
+        failures++;
+    }
+}
+
+int main()
+{
+    OGLCONSOLE_Console console = OGLCONSOLE_Create(), terminal;
+    int i, n;
+
+    /* Prepare() only plans ahead when there are threads to build on */
+    OGLCONSOLE_SetBuildThreads(2);
+
+    C->visible = 1;
+    C->transitionComplete = 0;
+    for (i = 0; i < 100; i++)
+        OGLCONSOLE_Output(console, "line %d\n", i);
+    OGLCONSOLE_SetPinnedRows(1, 0);
+    OGLCONSOLE_SetPinned(0, "pinned");
+
+    terminal = OGLCONSOLE_Create();
+    OGLCONSOLE_EditConsole(terminal);
+    ((_OGLCONSOLE_Console*)terminal)->visible = 1;
+    ((_OGLCONSOLE_Console*)terminal)->transitionComplete = 0;
+    OGLCONSOLE_SetTerminal(1);
+    for (i = 0; i < 100; i++)
+        OGLCONSOLE_Output(terminal, "row %d\r\n", i);
+
+    /* Neither is rendered, so the next frame has it all to compile again */
+    OGLCONSOLE_Prepare();
+    n = Compiles(console);
+    Expect("scrollback", n > 1, "the first plan compiles nothing");
+    i = Compiles(terminal);
+    Expect("terminal", i > 1, "the first plan compiles nothing");
+
+    OGLCONSOLE_Prepare();
+    Expect("scrollback", Compiles(console) == n,
+           "lists from the plan which wasn't drawn aren't compiled");
+    Expect("terminal", Compiles(terminal) == i,
+           "lists from the plan which wasn't drawn aren't compiled");
+
+    /* Once they're drawn, there's nothing left to compile */
+    OGLCONSOLE_Render(console);
+    OGLCONSOLE_Render(terminal);
+    OGLCONSOLE_Prepare();
+    Expect("scrollback", Compiles(console) == 0,
+           "lists which were drawn are compiled again");
+    Expect("terminal", Compiles(terminal) == 0,
+           "lists which were drawn are compiled again");
+
+    /* Nor when the plan is made by rendering */
+    OGLCONSOLE_Render(console);
+    OGLCONSOLE_Render(console);
+    Expect("render", Compiles(console) == 0,
+           "lists which were drawn are compiled again");
+
+    OGLCONSOLE_Quit();
+
+    if (failures)
+    {
+        printf("%d failed\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,218 @@
+/* Feeds recorded output to a console in terminal mode and checks what ends up
+ * on its screen and in its scrollback. Prints what doesn't match, and exits
+ * with 1 if anything didn't */
+
+#include "headless.h"
+
+static int failures = 0;
+
+/* Put output onto the console's screen the way a program's output gets there */
+static void Feed(OGLCONSOLE_Console console, const char *s)
+{
+    OGLCONSOLE_Ingest(C, s, strlen(s));
+}
+
+/* A row of the screen should hold text, and nothing but blanks after it */
+static void ExpectRow(OGLCONSOLE_Console console, const char *test, int row,
+                      const char *text)
+{
+    OGLCONSOLE_Terminal *t = C->terminal;
+    const char *cells = t->cells + row * t->columns;
+    int n = t->columns;
+
+    while (n > 0 && cells[n - 1] == ' ')
+        n--;
+
+    if (n != (int)strlen(text) || memcmp(cells, text, n))
+    {
+        printf("%s: row %d is \"%.*s\", not \"%s\"\n", test, row, n, cells,
+               text);
+        failures++;
+    }
+}
+
+static void ExpectCursor(OGLCONSOLE_Console console, const char *test, int x,
+                         int y)
+{
+    OGLCONSOLE_Terminal *t = C->terminal;
+
+    if (t->x != x || t->y != y)
+    {
+        printf("%s: cursor is at %d,%d, not %d,%d\n", test, t->x, t->y, x, y);
+        failures++;
+    }
+}
+
+/* The line back lines before the last one in the scrollback should be text */
+static void ExpectLine(OGLCONSOLE_Console console, const char *test, int back,
+                       const char *text)
+{
+    int n;
+    const char *s = OGLCONSOLE_LineText(C, C->lineQueueIndex - back, &n);
+
+    if (n != (int)strlen(text) || memcmp(s, text, n))
+    {
+        printf("%s: scrollback line -%d is \"%.*s\", not \"%s\"\n", test, back,
+               n, s, text);
+        failures++;
+    }
+}
+
+static void Expect(const char *test, int ok, const char *what)
+{
+    if (!ok)
+    {
+        printf("%s: %s\n", test, what);
+        failures++;
+    }
+}
+
+int main()
+{
+    OGLCONSOLE_Console console = OGLCONSOLE_Create(), other;
+    char text[256];
+    unsigned int red;
+    long lines;
+    int i;
+
+    OGLCONSOLE_SetTerminal(1);
+    Expect("size", C->terminal->columns == 80 && C->terminal->rows == 60,
+           "the screen isn't 80x60");
+
+    /* Moving about, inserting and deleting, and colors */
+    Feed(console, "\x1b[2J\x1b[Hhello\r\nworld\x1b[5;10Hat 5,10"
+                  "\x1b[1;31mred\x1b[0m\x1b[3;1HXXXXXXXXXX\x1b[3;4H\x1b[2P"
+                  "\x1b[3;1H\x1b[1@\x1b[3;8H\x1b[K");
+    ExpectRow(console, "editing", 0, "hello");
+    ExpectRow(console, "editing", 1, "world");
+    ExpectRow(console, "editing", 2, " XXXXXX");
+    ExpectRow(console, "editing", 4, "         at 5,10red");
+    ExpectCursor(console, "editing", 7, 2);
+    Expect("colors", C->terminal->colors[4 * 80 + 15] == 0
+                  && C->terminal->colors[4 * 80 + 16] != 0,
+           "only \"red\" should be colored");
+
+    /* Rows scrolled off the top go into the scrollback */
+    Feed(console, "\x1b[H\x1b[J");
+    for (i = 0; i < 70; i++)
+    {
+        sprintf(text, "row %d\r\n", i);
+        Feed(console, text);
+    }
+    ExpectRow(console, "scrolling", 0, "row 11");
+    ExpectRow(console, "scrolling", 58, "row 69");
+    ExpectCursor(console, "scrolling", 0, 59);
+    ExpectLine(console, "scrolling", 0, "row 10");
+    ExpectLine(console, "scrolling", 10, "row 0");
+
+    /* Scrolling regions, and reverse index */
+    Feed(console, "\x1b[2J\x1b[H1\r\n2\r\n3\r\n4\r\n5\x1b[2;4r\x1b[4;1H\n\nZ"
+                  "\x1b[r\x1b[2;1H\x1bMUP");
+    ExpectRow(console, "region", 0, "UP");
+    ExpectRow(console, "region", 1, "4");
+    ExpectRow(console, "region", 2, "");
+    ExpectRow(console, "region", 3, "Z");
+    ExpectRow(console, "region", 4, "5");
+    ExpectCursor(console, "region", 2, 0);
+
+    /* Text reaching the right edge leaves the cursor on the last column, so
+     * that backspacing and erasing start from there */
+    Feed(console, "\x1b[2J\x1b[1;78Habc");
+    ExpectCursor(console, "edge", 79, 0);
+    Feed(console, "\bX\x1b[2;76Hhello\x1b[K");
+    ExpectRow(console, "edge", 0, "                                        "
+                                  "                                     aXc");
+    ExpectRow(console, "edge", 1, "                                        "
+                                  "                                   hell");
+
+    /* Wrapping, and with it off, writing over the last column */
+    memset(text, 'a', 85);
+    text[85] = 0;
+    Feed(console, "\x1b[2J\x1b[H");
+    Feed(console, text);
+    Feed(console, "|\x1b[?7l\r\n");
+    memset(text, 'b', 90);
+    Feed(console, text);
+    Feed(console, "END");
+    ExpectRow(console, "wrap", 0, "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+                                  "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa");
+    ExpectRow(console, "wrap", 1, "aaaaa|");
+    ExpectRow(console, "wrap", 2, "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb"
+                                  "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbD");
+    ExpectCursor(console, "wrap", 79, 2);
+    Feed(console, "\x1b[31mZ");
+    ExpectRow(console, "wrap", 2, "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb"
+                                  "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbZ");
+    red = C->terminal->colors[2 * 80 + 79];
+    Feed(console, "\x1b[32mXY\x1b[0m\x1b[?7h");
+    ExpectRow(console, "wrap", 2, "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb"
+                                  "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbY");
+    Expect("wrap", red && C->terminal->colors[2 * 80 + 78] == 0
+                && C->terminal->colors[2 * 80 + 79]
+                && C->terminal->colors[2 * 80 + 79] != red,
+           "the last column isn't in the color it was written in");
+
+    /* Sequences cut off between writes, and OSC strings */
+    Feed(console, "\x1b[2J\x1b[1");
+    Feed(console, "0;2");
+    Feed(console, "0Hsplit\x1b]0;title\a!");
+    ExpectRow(console, "split", 9, "                   split!");
+    ExpectCursor(console, "split", 25, 9);
+
+    /* The alternate screen puts nothing into the scrollback, and the screen
+     * from before comes back afterwards, with the cursor for 1049 */
+    lines = C->lineQueueIndex;
+    Feed(console, "\x1b[?1049h");
+    ExpectRow(console, "alternate", 9, "");
+    for (i = 0; i < 100; i++)
+    {
+        sprintf(text, "alt %d\r\n", i);
+        Feed(console, text);
+    }
+    Feed(console, "\x1b[?1049l");
+    Expect("alternate", C->lineQueueIndex == lines,
+           "the alternate screen scrolled into the scrollback");
+    ExpectRow(console, "alternate", 9, "                   split!");
+    ExpectRow(console, "alternate", 59, "");
+    ExpectCursor(console, "alternate", 25, 9);
+
+    Feed(console, "\x1b[?47hother\x1b[?47l");
+    ExpectRow(console, "alternate 47", 0, "");
+    ExpectRow(console, "alternate 47", 9, "                   split!");
+
+    /* The same output a byte at a time ends up the same */
+    OGLCONSOLE_SetTerminal(0);
+    OGLCONSOLE_SetTerminal(1);
+    other = OGLCONSOLE_Create();
+    OGLCONSOLE_EditConsole(other);
+    OGLCONSOLE_SetTerminal(1);
+    {
+        const char *s = "\x1b[2J\x1b[H\x1b[1;32mgreen\x1b[0m\r\n\x1b[3;5Hx\x1b[2;"
+                        "3r\x1b[2;1H\n\n\x1b[r\x1b]2;t\x1b\\\x1b[?1049hy\x1b[?1049"
+                        "l\x1b[38;5;208mo\x1b[38;2;1;2;3mr";
+
+        Feed(console, s);
+        for (; *s; s++)
+            OGLCONSOLE_Ingest((_OGLCONSOLE_Console*)other, s, 1);
+
+        Expect("bytes", !memcmp(C->terminal->cells,
+                                ((_OGLCONSOLE_Console*)other)->terminal->cells,
+                                80 * 60)
+                     && !memcmp(C->terminal->colors,
+                                ((_OGLCONSOLE_Console*)other)->terminal->colors,
+                                80 * 60 * sizeof(unsigned int)),
+               "output a byte at a time came out differently");
+    }
+
+    OGLCONSOLE_EditConsole(console);
+    OGLCONSOLE_Destroy(other);
+    OGLCONSOLE_Quit();
+
+    if (failures)
+    {
+        printf("%d failed\n", failures);
+        return 1;
+    }
+
+    return 0;
+}